@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// axis aligned box of a collider in world space, in the float precision of the transforms
+struct CollisionBox {
+	float x;
+	float y;
+	float width;
+	float height;
+};
+
+// same test the collision system has always used, touching edges do not overlap
+inline bool BoxesOverlap(const CollisionBox& a, const CollisionBox& b) {
+	return (
+		a.x < b.x + b.width &&
+		a.x + a.width > b.x &&
+		a.y < b.y + b.height &&
+		a.y + a.height > b.y
+		);
+}
+
+// most collision layers, every layer is one bit of a mask
+const int MAX_COLLISION_LAYERS = 32;
+const int DEFAULT_COLLISION_LAYER = 0;
+const uint32_t COLLISION_MASK_ALL = 0xFFFFFFFF;
+
+// layer bit of a box and the layers it collides with
+struct CollisionFilter {
+	uint32_t layerBit;
+	uint32_t mask;
+};
+
+// both boxes have to collide with the other's layer
+inline bool FiltersInteract(const CollisionFilter& a, const CollisionFilter& b) {
+	return (a.mask & b.layerBit) != 0 && (b.mask & a.layerBit) != 0;
+}
+
+// fraction of the segment from -> to at which it enters the box min..max, false if it misses
+inline bool SegmentHitsBounds(const glm::dvec2& from, const glm::dvec2& to, const glm::dvec2& boxMin, const glm::dvec2& boxMax, double& fraction) {
+	const glm::dvec2 direction = to - from;
+	double enter = 0;
+	double leave = 1;
+	for (int axis = 0; axis < 2; axis++) {
+		if (std::abs(direction[axis]) < 1e-12) {
+			if (from[axis] < boxMin[axis] || from[axis] > boxMax[axis]) {
+				return false;
+			}
+			continue;
+		}
+		double lower = (boxMin[axis] - from[axis]) / direction[axis];
+		double upper = (boxMax[axis] - from[axis]) / direction[axis];
+		if (lower > upper) {
+			std::swap(lower, upper);
+		}
+		enter = std::max(enter, lower);
+		leave = std::min(leave, upper);
+		if (enter > leave) {
+			return false;
+		}
+	}
+	fraction = enter;
+	return true;
+}
+
+inline bool SegmentHitsBox(const glm::dvec2& from, const glm::dvec2& to, const CollisionBox& box, double& fraction) {
+	return SegmentHitsBounds(from, to, glm::dvec2(box.x, box.y), glm::dvec2(box.x + box.width, box.y + box.height), fraction);
+}
+
+// indices of two overlapping boxes, first < second
+typedef std::pair<int, int> CollisionPair;
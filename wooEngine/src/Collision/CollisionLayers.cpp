@@ -0,0 +1,37 @@
+#include "CollisionLayers.h"
+#include "../Logger/Logger.h"
+
+SymbolTable CollisionLayers::layerSymbols;
+
+int CollisionLayers::Intern(const std::string& name) {
+	// interning is idempotent, so racing threads both get "default" as layer 0
+	if (layerSymbols.GetSize() == 0) {
+		layerSymbols.Intern("default");
+	}
+
+	const int layer = layerSymbols.Intern(name);
+	if (layer >= MAX_COLLISION_LAYERS) {
+		Logger::Err("Collision layer limit reached, " + name + " uses the default layer.");
+		return DEFAULT_COLLISION_LAYER;
+	}
+	return layer;
+}
+
+std::string CollisionLayers::GetName(int layer) {
+	if (layer == DEFAULT_COLLISION_LAYER) {
+		return "default";
+	}
+	return layerSymbols.GetName(layer);
+}
+
+int CollisionLayers::GetNumLayers() {
+	return std::max(1, std::min(layerSymbols.GetSize(), MAX_COLLISION_LAYERS));
+}
+
+uint32_t CollisionLayers::GetMask(const std::vector<std::string>& names) {
+	uint32_t mask = 0;
+	for (const auto& name : names) {
+		mask |= 1u << Intern(name);
+	}
+	return mask;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../ECS/ECS.h"
+#include "CollisionBox.h"
+#include <string>
+
+///////////////////////////////////////////////////
+// CollisionLayers
+///////////////////////////////////////////////////
+// names of the collision layers, interned like groups
+// "default" is always layer 0, and at most MAX_COLLISION_LAYERS layers exist
+///////////////////////////////////////////////////
+
+class CollisionLayers {
+private:
+	static SymbolTable layerSymbols;
+
+public:
+	// layer of the name, DEFAULT_COLLISION_LAYER once the limit is reached
+	// ie: const int projectilesLayer = CollisionLayers::Intern("projectiles");
+	static int Intern(const std::string& name);
+	static std::string GetName(int layer);
+	static int GetNumLayers();
+
+	// mask with the bit of every named layer
+	static uint32_t GetMask(const std::vector<std::string>& names);
+};
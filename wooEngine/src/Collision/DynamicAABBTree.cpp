@@ -0,0 +1,325 @@
+#include "DynamicAABBTree.h"
+#include "../Logger/Logger.h"
+#include <string>
+
+DynamicAABBTree::Bounds DynamicAABBTree::ToBounds(const CollisionBox& box) {
+	return { box.x, box.y, box.x + box.width, box.y + box.height };
+}
+
+DynamicAABBTree::Bounds DynamicAABBTree::Fatten(const CollisionBox& box) const {
+	const Bounds bounds = ToBounds(box);
+	return { bounds.minX - margin, bounds.minY - margin, bounds.maxX + margin, bounds.maxY + margin };
+}
+
+DynamicAABBTree::Bounds DynamicAABBTree::Union(const Bounds& a, const Bounds& b) {
+	return { std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY) };
+}
+
+double DynamicAABBTree::Perimeter(const Bounds& box) {
+	return 2 * ((static_cast<double>(box.maxX) - box.minX) + (static_cast<double>(box.maxY) - box.minY));
+}
+
+bool DynamicAABBTree::Contains(const Bounds& outer, const Bounds& inner) {
+	return outer.minX <= inner.minX && outer.minY <= inner.minY && inner.maxX <= outer.maxX && inner.maxY <= outer.maxY;
+}
+
+bool DynamicAABBTree::Overlap(const Bounds& a, const Bounds& b) {
+	return a.minX < b.maxX && a.maxX > b.minX && a.minY < b.maxY && a.maxY > b.minY;
+}
+
+bool DynamicAABBTree::SegmentHits(const glm::dvec2& from, const glm::dvec2& to, double maxFraction, const Bounds& box) {
+	double fraction;
+	return SegmentHitsBounds(from, to, glm::dvec2(box.minX, box.minY), glm::dvec2(box.maxX, box.maxY), fraction) && fraction <= maxFraction;
+}
+
+int DynamicAABBTree::AllocateNode() {
+	int node;
+	if (freeList != NULL_NODE) {
+		node = freeList;
+		freeList = nodes[node].parent;
+	} else {
+		node = static_cast<int>(nodes.size());
+		nodes.emplace_back();
+	}
+	nodes[node].parent = NULL_NODE;
+	nodes[node].child1 = NULL_NODE;
+	nodes[node].child2 = NULL_NODE;
+	nodes[node].userData = -1;
+	nodes[node].layerBits = 0;
+	nodes[node].height = 0;
+	return node;
+}
+
+void DynamicAABBTree::FreeNode(int node) {
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void DynamicAABBTree::InsertLeaf(int leaf) {
+	if (root == NULL_NODE) {
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	// walk down towards the sibling whose union with the leaf adds the least surface area
+	// cost of a node is the perimeter of its box, every ancestor of the new parent grows too
+	const Bounds& leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		const double perimeter = Perimeter(node.box);
+		const double combinedPerimeter = Perimeter(Union(node.box, leafBox));
+
+		// cost of making a new parent for this node and the leaf
+		const double cost = 2 * combinedPerimeter;
+
+		// growth of this node if the leaf goes further down
+		const double inheritedCost = 2 * (combinedPerimeter - perimeter);
+
+		double childCosts[2];
+		const int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++) {
+			const Node& child = nodes[children[i]];
+			const double unionPerimeter = Perimeter(Union(child.box, leafBox));
+			childCosts[i] = (child.IsLeaf() ? unionPerimeter : unionPerimeter - Perimeter(child.box)) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1]) {
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	const int sibling = index;
+	const int oldParent = nodes[sibling].parent;
+	const int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	Refit(newParent);
+
+	if (oldParent == NULL_NODE) {
+		root = newParent;
+	} else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	} else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	RefitAncestors(oldParent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int leaf) {
+	if (leaf == root) {
+		root = NULL_NODE;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	const int parent = nodes[leaf].parent;
+	const int grandParent = nodes[parent].parent;
+	const int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent == NULL_NODE) {
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+	} else {
+		ReplaceChild(grandParent, parent, sibling);
+	}
+	FreeNode(parent);
+
+	RefitAncestors(grandParent);
+}
+
+void DynamicAABBTree::ReplaceChild(int parent, int oldChild, int newChild) {
+	if (nodes[parent].child1 == oldChild) {
+		nodes[parent].child1 = newChild;
+	} else {
+		nodes[parent].child2 = newChild;
+	}
+	nodes[newChild].parent = parent;
+}
+
+void DynamicAABBTree::Refit(int node) {
+	const Node& child1 = nodes[nodes[node].child1];
+	const Node& child2 = nodes[nodes[node].child2];
+	nodes[node].box = Union(child1.box, child2.box);
+	nodes[node].layerBits = child1.layerBits | child2.layerBits;
+	nodes[node].height = 1 + std::max(child1.height, child2.height);
+}
+
+void DynamicAABBTree::Rotate(int node) {
+	// a child of the node can swap places with a grandchild under its sibling, which
+	// shrinks the sibling when the two nodes left under it are closer together
+	// the box of the node itself does not change
+	if (nodes[node].height < 2) {
+		return;
+	}
+
+	double bestGain = 0;
+	int bestChild = NULL_NODE;
+	int bestSibling = NULL_NODE;
+	int bestGrandChild = NULL_NODE;
+
+	const int children[2] = { nodes[node].child1, nodes[node].child2 };
+	for (int i = 0; i < 2; i++) {
+		const int child = children[i];
+		const int sibling = children[1 - i];
+		if (nodes[sibling].IsLeaf()) {
+			continue;
+		}
+
+		const int grandChildren[2] = { nodes[sibling].child1, nodes[sibling].child2 };
+		for (int j = 0; j < 2; j++) {
+			// child goes down next to the grandchild that stays
+			const double gain = Perimeter(nodes[sibling].box) - Perimeter(Union(nodes[child].box, nodes[grandChildren[1 - j]].box));
+			if (gain > bestGain) {
+				bestGain = gain;
+				bestChild = child;
+				bestSibling = sibling;
+				bestGrandChild = grandChildren[j];
+			}
+		}
+	}
+
+	if (bestChild == NULL_NODE) {
+		return;
+	}
+
+	ReplaceChild(node, bestChild, bestGrandChild);
+	ReplaceChild(bestSibling, bestGrandChild, bestChild);
+	Refit(bestSibling);
+	Refit(node);
+}
+
+int DynamicAABBTree::Balance(int node) {
+	if (nodes[node].height < 2) {
+		return node;
+	}
+
+	const int child1 = nodes[node].child1;
+	const int child2 = nodes[node].child2;
+	const int balance = nodes[child2].height - nodes[child1].height;
+	if (balance >= -1 && balance <= 1) {
+		return node;
+	}
+
+	// the taller child takes the place of the node, which keeps the shorter child and
+	// the shorter grandchild, the taller grandchild stays under the lifted child
+	const int tall = balance > 1 ? child2 : child1;
+	const int grandChild1 = nodes[tall].child1;
+	const int grandChild2 = nodes[tall].child2;
+	const int tallGrandChild = nodes[grandChild1].height > nodes[grandChild2].height ? grandChild1 : grandChild2;
+	const int shortGrandChild = tallGrandChild == grandChild1 ? grandChild2 : grandChild1;
+
+	const int parent = nodes[node].parent;
+	if (parent == NULL_NODE) {
+		root = tall;
+		nodes[tall].parent = NULL_NODE;
+	} else {
+		ReplaceChild(parent, node, tall);
+	}
+
+	ReplaceChild(node, tall, shortGrandChild);
+	nodes[tall].child1 = node;
+	nodes[tall].child2 = tallGrandChild;
+	nodes[node].parent = tall;
+	nodes[tallGrandChild].parent = tall;
+	Refit(node);
+	Refit(tall);
+	return tall;
+}
+
+void DynamicAABBTree::RefitAncestors(int node) {
+	while (node != NULL_NODE) {
+		Refit(node);
+		const int balanced = Balance(node);
+		if (balanced == node) {
+			Rotate(node);
+		}
+		node = nodes[balanced].parent;
+	}
+}
+
+void DynamicAABBTree::SetMargin(float margin) {
+	if (margin < 0) {
+		Logger::Err("AABB tree margin must not be negative, got " + std::to_string(margin));
+		return;
+	}
+	this->margin = margin;
+}
+
+float DynamicAABBTree::GetMargin() const {
+	return margin;
+}
+
+int DynamicAABBTree::CreateProxy(const CollisionBox& box, int userData, uint32_t layerBits) {
+	const int proxy = AllocateNode();
+	nodes[proxy].box = Fatten(box);
+	nodes[proxy].userData = userData;
+	nodes[proxy].layerBits = layerBits;
+	InsertLeaf(proxy);
+	numProxies++;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(int proxy) {
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	numProxies--;
+}
+
+bool DynamicAABBTree::MoveProxy(int proxy, const CollisionBox& box) {
+	const Bounds bounds = ToBounds(box);
+	if (Contains(nodes[proxy].box, bounds)) {
+		return false;
+	}
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = Fatten(box);
+	InsertLeaf(proxy);
+	return true;
+}
+
+int DynamicAABBTree::GetUserData(int proxy) const {
+	return nodes[proxy].userData;
+}
+
+void DynamicAABBTree::SetUserData(int proxy, int userData) {
+	nodes[proxy].userData = userData;
+}
+
+uint32_t DynamicAABBTree::GetLayerBits(int proxy) const {
+	return nodes[proxy].layerBits;
+}
+
+void DynamicAABBTree::SetLayerBits(int proxy, uint32_t layerBits) {
+	nodes[proxy].layerBits = layerBits;
+	for (int node = nodes[proxy].parent; node != NULL_NODE; node = nodes[node].parent) {
+		nodes[node].layerBits = nodes[nodes[node].child1].layerBits | nodes[nodes[node].child2].layerBits;
+	}
+}
+
+CollisionBox DynamicAABBTree::GetFatBox(int proxy) const {
+	const Bounds& box = nodes[proxy].box;
+	return { box.minX, box.minY, box.maxX - box.minX, box.maxY - box.minY };
+}
+
+int DynamicAABBTree::GetNumProxies() const {
+	return numProxies;
+}
+
+int DynamicAABBTree::GetHeight() const {
+	return root == NULL_NODE ? 0 : nodes[root].height;
+}
+
+void DynamicAABBTree::Clear() {
+	nodes.clear();
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+	numProxies = 0;
+}
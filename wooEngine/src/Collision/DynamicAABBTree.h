@@ -0,0 +1,192 @@
+#pragma once
+
+#include "CollisionBox.h"
+#include <vector>
+
+// distance every box is grown by when inserted, small moves stay inside it
+const float DEFAULT_AABB_TREE_MARGIN = 8.0f;
+
+///////////////////////////////////////////////////
+// DynamicAABBTree
+///////////////////////////////////////////////////
+// bounding volume hierarchy of boxes that move every frame
+// every proxy is stored with a fat box grown by a margin, so a box that moves a
+// little stays inside it and the tree is only touched when it leaves its fat box
+// leaves are inserted next to the sibling that grows the tree's surface area the least,
+// and every node refitted on the way back up is rebalanced when the heights of its
+// children differ by more than one, otherwise rotated when swapping one of its
+// children with a grandchild makes the tree smaller (perimeter is the 2d surface area)
+// balancing keeps identical or nested boxes, which no rotation shrinks, from forming a chain
+// node indices are proxy ids, removed nodes are reused through a free list
+///////////////////////////////////////////////////
+
+class DynamicAABBTree {
+private:
+	struct Bounds {
+		float minX;
+		float minY;
+		float maxX;
+		float maxY;
+	};
+
+	struct Node {
+		Bounds box;
+		// next free node while the node is unused
+		int parent;
+		int child1;
+		int child2;
+		int userData;
+		// layer bits of every proxy under the node, queries skip nodes without any of theirs
+		uint32_t layerBits;
+		// leaves are 0, unused nodes -1
+		int height;
+
+		bool IsLeaf() const {
+			return child1 == NULL_NODE;
+		}
+	};
+
+	static const int NULL_NODE = -1;
+	static const int SMALL_STACK_SIZE = 64;
+
+	std::vector<Node> nodes;
+	int root = NULL_NODE;
+	int freeList = NULL_NODE;
+	int numProxies = 0;
+	float margin = DEFAULT_AABB_TREE_MARGIN;
+
+	static Bounds ToBounds(const CollisionBox& box);
+	Bounds Fatten(const CollisionBox& box) const;
+	static Bounds Union(const Bounds& a, const Bounds& b);
+	static double Perimeter(const Bounds& box);
+	static bool Contains(const Bounds& outer, const Bounds& inner);
+	static bool Overlap(const Bounds& a, const Bounds& b);
+	static bool SegmentHits(const glm::dvec2& from, const glm::dvec2& to, double maxFraction, const Bounds& box);
+
+	int AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void ReplaceChild(int parent, int oldChild, int newChild);
+	void Refit(int node);
+	void Rotate(int node);
+	// lifts the taller child when the heights of the children differ by more than one, returns the node now in its place
+	int Balance(int node);
+	// refits and balances or rotates every node from node up to the root
+	void RefitAncestors(int node);
+
+	template <typename TCallback> void Query(const Bounds& box, uint32_t mask, TCallback& callback, int* stack) const;
+	template <typename TCallback> void RayCast(const glm::dvec2& from, const glm::dvec2& to, TCallback& callback, int* stack) const;
+
+public:
+	void SetMargin(float margin);
+	float GetMargin() const;
+
+	// adds a box and returns its proxy id
+	int CreateProxy(const CollisionBox& box, int userData, uint32_t layerBits = COLLISION_MASK_ALL);
+	void DestroyProxy(int proxy);
+
+	// moves a proxy, the tree only changes if the box left its fat box, which is returned
+	bool MoveProxy(int proxy, const CollisionBox& box);
+
+	int GetUserData(int proxy) const;
+	void SetUserData(int proxy, int userData);
+	uint32_t GetLayerBits(int proxy) const;
+	void SetLayerBits(int proxy, uint32_t layerBits);
+	CollisionBox GetFatBox(int proxy) const;
+
+	int GetNumProxies() const;
+	int GetHeight() const;
+	void Clear();
+
+	// calls callback(proxy) for every proxy whose fat box overlaps the box and whose layer bits are in the mask
+	// the callback returns false to stop the query
+	template <typename TCallback> void Query(const CollisionBox& box, uint32_t mask, TCallback callback) const;
+	template <typename TCallback> void Query(const CollisionBox& box, TCallback callback) const;
+
+	// calls callback(proxy, maxFraction) for every proxy whose fat box the segment from -> to crosses
+	// before maxFraction, the callback returns the new maxFraction to clip the segment to, 0 stops the cast
+	template <typename TCallback> void RayCast(const glm::dvec2& from, const glm::dvec2& to, TCallback callback) const;
+};
+
+template <typename TCallback>
+void DynamicAABBTree::Query(const CollisionBox& box, TCallback callback) const {
+	Query(box, COLLISION_MASK_ALL, callback);
+}
+
+template <typename TCallback>
+void DynamicAABBTree::Query(const CollisionBox& box, uint32_t mask, TCallback callback) const {
+	if (root == NULL_NODE) {
+		return;
+	}
+
+	// a depth first walk never holds more nodes than the height of the tree plus two
+	const int stackSize = nodes[root].height + 2;
+	if (stackSize <= SMALL_STACK_SIZE) {
+		int stack[SMALL_STACK_SIZE];
+		Query(ToBounds(box), mask, callback, stack);
+	} else {
+		std::vector<int> stack(stackSize);
+		Query(ToBounds(box), mask, callback, stack.data());
+	}
+}
+
+template <typename TCallback>
+void DynamicAABBTree::Query(const Bounds& box, uint32_t mask, TCallback& callback, int* stack) const {
+	int count = 0;
+	stack[count++] = root;
+	while (count > 0) {
+		const Node& node = nodes[stack[--count]];
+		if ((node.layerBits & mask) == 0 || !Overlap(node.box, box)) {
+			continue;
+		}
+
+		if (node.IsLeaf()) {
+			if (!callback(static_cast<int>(&node - nodes.data()))) {
+				return;
+			}
+		} else {
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
+
+template <typename TCallback>
+void DynamicAABBTree::RayCast(const glm::dvec2& from, const glm::dvec2& to, TCallback callback) const {
+	if (root == NULL_NODE) {
+		return;
+	}
+
+	const int stackSize = nodes[root].height + 2;
+	if (stackSize <= SMALL_STACK_SIZE) {
+		int stack[SMALL_STACK_SIZE];
+		RayCast(from, to, callback, stack);
+	} else {
+		std::vector<int> stack(stackSize);
+		RayCast(from, to, callback, stack.data());
+	}
+}
+
+template <typename TCallback>
+void DynamicAABBTree::RayCast(const glm::dvec2& from, const glm::dvec2& to, TCallback& callback, int* stack) const {
+	double maxFraction = 1;
+	int count = 0;
+	stack[count++] = root;
+	while (count > 0) {
+		const Node& node = nodes[stack[--count]];
+		if (!SegmentHits(from, to, maxFraction, node.box)) {
+			continue;
+		}
+
+		if (node.IsLeaf()) {
+			maxFraction = callback(static_cast<int>(&node - nodes.data()), maxFraction);
+			if (maxFraction <= 0) {
+				return;
+			}
+		} else {
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
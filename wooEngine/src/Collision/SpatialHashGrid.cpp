@@ -0,0 +1,108 @@
+#include "SpatialHashGrid.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+#include <cmath>
+
+int SpatialHashGrid::GetCell(double coordinate) const {
+	return static_cast<int>(std::floor(coordinate / cellSize));
+}
+
+uint32_t SpatialHashGrid::GetBucket(int cellX, int cellY, uint32_t bucketMask) const {
+	return ((static_cast<uint32_t>(cellX) * 73856093u) ^ (static_cast<uint32_t>(cellY) * 19349663u)) & bucketMask;
+}
+
+void SpatialHashGrid::SetCellSize(double cellSize) {
+	if (cellSize <= 0) {
+		Logger::Err("Collision cell size must be positive, got " + std::to_string(cellSize));
+		return;
+	}
+	this->cellSize = cellSize;
+}
+
+double SpatialHashGrid::GetCellSize() const {
+	return cellSize;
+}
+
+void SpatialHashGrid::FindOverlappingPairs(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, std::vector<CollisionPair>& pairs) {
+	numTests = 0;
+
+	// one entry per covered cell
+	entries.clear();
+	for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+		const CollisionBox& box = boxes[i];
+		const int minX = GetCell(box.x);
+		const int maxX = GetCell(box.x + box.width);
+		const int minY = GetCell(box.y);
+		const int maxY = GetCell(box.y + box.height);
+		for (int cellY = minY; cellY <= maxY; cellY++) {
+			for (int cellX = minX; cellX <= maxX; cellX++) {
+				entries.push_back({ i, cellX, cellY });
+			}
+		}
+	}
+
+	// at least twice as many buckets as entries keeps unrelated cells apart
+	uint32_t numBuckets = 64;
+	while (numBuckets < entries.size() * 2) {
+		numBuckets *= 2;
+	}
+	const uint32_t bucketMask = numBuckets - 1;
+
+	// counting sort of the entries by bucket, boxes stay in index order within a bucket
+	bucketStarts.assign(numBuckets + 1, 0);
+	for (const Entry& entry : entries) {
+		bucketStarts[GetBucket(entry.cellX, entry.cellY, bucketMask) + 1]++;
+	}
+	for (uint32_t bucket = 0; bucket < numBuckets; bucket++) {
+		bucketStarts[bucket + 1] += bucketStarts[bucket];
+	}
+	sortedEntries.resize(entries.size());
+	for (const Entry& entry : entries) {
+		sortedEntries[bucketStarts[GetBucket(entry.cellX, entry.cellY, bucketMask)]++] = entry;
+	}
+
+	// the fill advanced every start to the start of the next bucket
+	const size_t firstPair = pairs.size();
+	int bucketStart = 0;
+	for (uint32_t bucket = 0; bucket < numBuckets; bucket++) {
+		const int bucketEnd = bucketStarts[bucket];
+		for (int i = bucketStart; i < bucketEnd; i++) {
+			const Entry& a = sortedEntries[i];
+			for (int j = i + 1; j < bucketEnd; j++) {
+				const Entry& b = sortedEntries[j];
+
+				// different cells can hash to the same bucket
+				if (a.cellX != b.cellX || a.cellY != b.cellY) {
+					continue;
+				}
+
+				// layers that ignore each other are rejected before the box test
+				if (!FiltersInteract(filters[a.box], filters[b.box])) {
+					continue;
+				}
+
+				numTests++;
+				const CollisionBox& boxA = boxes[a.box];
+				const CollisionBox& boxB = boxes[b.box];
+				if (!BoxesOverlap(boxA, boxB)) {
+					continue;
+				}
+
+				// boxes covering several cells together are only reported by the first one
+				if (GetCell(std::max(boxA.x, boxB.x)) != a.cellX || GetCell(std::max(boxA.y, boxB.y)) != a.cellY) {
+					continue;
+				}
+
+				pairs.push_back({ a.box, b.box });
+			}
+		}
+		bucketStart = bucketEnd;
+	}
+
+	// report pairs in the order a pairwise loop over the boxes would find them
+	std::sort(pairs.begin() + firstPair, pairs.end());
+}
+
+int SpatialHashGrid::GetNumTests() const {
+	return numTests;
+}
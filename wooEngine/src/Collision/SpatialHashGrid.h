@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CollisionBox.h"
+#include <cstdint>
+#include <vector>
+
+// width and height of a grid cell unless the level sets one
+const double DEFAULT_COLLISION_CELL_SIZE = 64.0;
+
+///////////////////////////////////////////////////
+// SpatialHashGrid
+///////////////////////////////////////////////////
+// broadphase that buckets boxes by the grid cells they cover
+// cells are hashed into a table sized from the number of entries and filled with a
+// counting sort, so building the grid costs one entry per covered cell and no allocation
+// once the buffers have grown. only boxes sharing a cell are tested against each other,
+// and a pair is reported from the one cell holding the top left corner of its overlap
+///////////////////////////////////////////////////
+
+class SpatialHashGrid {
+private:
+	struct Entry {
+		int box;
+		int cellX;
+		int cellY;
+	};
+
+	double cellSize = DEFAULT_COLLISION_CELL_SIZE;
+
+	std::vector<Entry> entries;
+	std::vector<Entry> sortedEntries;
+	std::vector<int> bucketStarts;
+	int numTests = 0;
+
+	int GetCell(double coordinate) const;
+	uint32_t GetBucket(int cellX, int cellY, uint32_t bucketMask) const;
+
+public:
+	void SetCellSize(double cellSize);
+	double GetCellSize() const;
+
+	// appends every overlapping pair of boxes whose filters interact, ordered by first then second index
+	void FindOverlappingPairs(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, std::vector<CollisionPair>& pairs);
+
+	// box pairs sharing a cell with interacting layers in the last query, each one tested for overlap
+	int GetNumTests() const;
+};
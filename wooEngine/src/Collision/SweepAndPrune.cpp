@@ -0,0 +1,181 @@
+#include "SweepAndPrune.h"
+#include <cfloat>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WOO_SWEEP_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WOO_SWEEP_SSE
+#endif
+
+// boxes tested per step of the sweep
+#if defined(WOO_SWEEP_AVX)
+const int SWEEP_WIDTH = 8;
+#elif defined(WOO_SWEEP_SSE)
+const int SWEEP_WIDTH = 4;
+#else
+const int SWEEP_WIDTH = 1;
+#endif
+
+void SweepAndPrune::Sort(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, const std::vector<int>& keys) {
+	frame++;
+	for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+		const int key = keys[i];
+		if (key >= static_cast<int>(boxOfKey.size())) {
+			boxOfKey.resize(key + 1, -1);
+			frameOfKey.resize(key + 1, 0);
+			isKeyInOrder.resize(key + 1, false);
+		}
+		boxOfKey[key] = i;
+		frameOfKey[key] = frame;
+	}
+
+	// boxes still there keep the order of the last frame
+	sortEntries.clear();
+	for (int key : order) {
+		if (frameOfKey[key] == frame) {
+			const int box = boxOfKey[key];
+			sortEntries.push_back({ boxes[box].x, box });
+		} else {
+			isKeyInOrder[key] = false;
+		}
+	}
+	const size_t numKept = sortEntries.size();
+	for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+		if (!isKeyInOrder[keys[i]]) {
+			sortEntries.push_back({ boxes[i].x, i });
+			isKeyInOrder[keys[i]] = true;
+		}
+	}
+
+	// boxes only moved a little since the last frame, so few entries move far
+	for (size_t i = 1; i < numKept; i++) {
+		const SortEntry entry = sortEntries[i];
+		size_t j = i;
+		while (j > 0 && sortEntries[j - 1].minX > entry.minX) {
+			sortEntries[j] = sortEntries[j - 1];
+			j--;
+		}
+		sortEntries[j] = entry;
+	}
+
+	// new boxes can be anywhere, they are sorted on their own and merged in
+	if (numKept < sortEntries.size()) {
+		const auto compare = [](const SortEntry& a, const SortEntry& b) { return a.minX < b.minX; };
+		std::sort(sortEntries.begin() + numKept, sortEntries.end(), compare);
+		std::inplace_merge(sortEntries.begin(), sortEntries.begin() + numKept, sortEntries.end(), compare);
+	}
+
+	order.clear();
+	for (const SortEntry& entry : sortEntries) {
+		order.push_back(keys[entry.box]);
+	}
+
+	// padding boxes start past every box and end before every box, so they stop the sweep
+	const size_t paddedSize = sortEntries.size() + SWEEP_WIDTH;
+	minX.resize(paddedSize);
+	maxX.resize(paddedSize);
+	minY.resize(paddedSize);
+	maxY.resize(paddedSize);
+	layerBits.resize(paddedSize);
+	masks.resize(paddedSize);
+	sortedBoxes.resize(sortEntries.size());
+	for (size_t i = 0; i < sortEntries.size(); i++) {
+		const CollisionBox& box = boxes[sortEntries[i].box];
+		minX[i] = box.x;
+		maxX[i] = box.x + box.width;
+		minY[i] = box.y;
+		maxY[i] = box.y + box.height;
+		layerBits[i] = filters[sortEntries[i].box].layerBit;
+		masks[i] = filters[sortEntries[i].box].mask;
+		sortedBoxes[i] = sortEntries[i].box;
+	}
+	for (size_t i = sortEntries.size(); i < paddedSize; i++) {
+		minX[i] = FLT_MAX;
+		maxX[i] = -FLT_MAX;
+		minY[i] = FLT_MAX;
+		maxY[i] = -FLT_MAX;
+		layerBits[i] = 0;
+		masks[i] = 0;
+	}
+}
+
+#if defined(WOO_SWEEP_AVX) || defined(WOO_SWEEP_SSE)
+// all bits set in the lanes of the four boxes whose layers and the layer of box i ignore each other
+static __m128 IgnoredLayers(const uint32_t* layerBits, const uint32_t* masks, uint32_t layerBit, uint32_t mask) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ignoredByOthers = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(masks)), _mm_set1_epi32(static_cast<int>(layerBit))), zero);
+	const __m128i ignoredByBox = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(layerBits)), _mm_set1_epi32(static_cast<int>(mask))), zero);
+	return _mm_castsi128_ps(_mm_or_si128(ignoredByOthers, ignoredByBox));
+}
+#endif
+
+void SweepAndPrune::Sweep(std::vector<CollisionPair>& pairs) {
+	const int numBoxes = static_cast<int>(sortedBoxes.size());
+	for (int i = 0; i < numBoxes; i++) {
+		// boxes after i start at or after its left edge, the sweep ends at the first one starting past its right edge
+		// the padding guarantees a full step can always be read
+		for (int j = i + 1; ; j += SWEEP_WIDTH) {
+#if defined(WOO_SWEEP_AVX)
+			const __m256 inRange = _mm256_cmp_ps(_mm256_loadu_ps(&minX[j]), _mm256_set1_ps(maxX[i]), _CMP_LT_OQ);
+			__m256 overlap = _mm256_and_ps(inRange, _mm256_cmp_ps(_mm256_set1_ps(minX[i]), _mm256_loadu_ps(&maxX[j]), _CMP_LT_OQ));
+			overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_loadu_ps(&minY[j]), _mm256_set1_ps(maxY[i]), _CMP_LT_OQ));
+			overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_set1_ps(minY[i]), _mm256_loadu_ps(&maxY[j]), _CMP_LT_OQ));
+			// avx has no integer compares, the layers are filtered in two sse halves
+			const __m128 ignoredLow = IgnoredLayers(&layerBits[j], &masks[j], layerBits[i], masks[i]);
+			const __m128 ignoredHigh = IgnoredLayers(&layerBits[j + 4], &masks[j + 4], layerBits[i], masks[i]);
+			overlap = _mm256_andnot_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(ignoredLow), ignoredHigh, 1), overlap);
+			const int inRangeMask = _mm256_movemask_ps(inRange);
+			const int overlapMask = _mm256_movemask_ps(overlap);
+#elif defined(WOO_SWEEP_SSE)
+			const __m128 inRange = _mm_cmplt_ps(_mm_loadu_ps(&minX[j]), _mm_set1_ps(maxX[i]));
+			__m128 overlap = _mm_and_ps(inRange, _mm_cmplt_ps(_mm_set1_ps(minX[i]), _mm_loadu_ps(&maxX[j])));
+			overlap = _mm_and_ps(overlap, _mm_cmplt_ps(_mm_loadu_ps(&minY[j]), _mm_set1_ps(maxY[i])));
+			overlap = _mm_and_ps(overlap, _mm_cmplt_ps(_mm_set1_ps(minY[i]), _mm_loadu_ps(&maxY[j])));
+			overlap = _mm_andnot_ps(IgnoredLayers(&layerBits[j], &masks[j], layerBits[i], masks[i]), overlap);
+			const int inRangeMask = _mm_movemask_ps(inRange);
+			const int overlapMask = _mm_movemask_ps(overlap);
+#else
+			const int inRangeMask = minX[j] < maxX[i];
+			const int overlapMask = inRangeMask && minX[i] < maxX[j] && minY[j] < maxY[i] && minY[i] < maxY[j] &&
+				FiltersInteract({ layerBits[i], masks[i] }, { layerBits[j], masks[j] });
+#endif
+			// lanes in range are a prefix, since the boxes are sorted
+			for (int lane = 0; lane < SWEEP_WIDTH && (inRangeMask & (1 << lane)); lane++) {
+				numTests++;
+				if (overlapMask & (1 << lane)) {
+					const int a = sortedBoxes[i];
+					const int b = sortedBoxes[j + lane];
+					pairs.push_back(a < b ? CollisionPair(a, b) : CollisionPair(b, a));
+				}
+			}
+
+			if (inRangeMask != (1 << SWEEP_WIDTH) - 1) {
+				break;
+			}
+		}
+	}
+}
+
+void SweepAndPrune::FindOverlappingPairs(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, const std::vector<int>& keys, std::vector<CollisionPair>& pairs) {
+	numTests = 0;
+	Sort(boxes, filters, keys);
+
+	const size_t firstPair = pairs.size();
+	Sweep(pairs);
+
+	// report pairs in the order a pairwise loop over the boxes would find them
+	std::sort(pairs.begin() + firstPair, pairs.end());
+}
+
+int SweepAndPrune::GetNumTests() const {
+	return numTests;
+}
+
+void SweepAndPrune::Clear() {
+	order.clear();
+	boxOfKey.clear();
+	frameOfKey.clear();
+	isKeyInOrder.clear();
+}
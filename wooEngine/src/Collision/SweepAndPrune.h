@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CollisionBox.h"
+#include <vector>
+
+///////////////////////////////////////////////////
+// SweepAndPrune
+///////////////////////////////////////////////////
+// broadphase that sorts boxes by their left edge and sweeps along the x axis
+// the bounds are kept as separate minX/maxX/minY/maxY float arrays in sorted order, and each
+// box is tested against the boxes after it four at a time with sse (eight with avx) until one
+// starts past its right edge. the order of the last frame is kept by key, so an insertion sort
+// of nearly sorted data is all that is needed while things move a little each frame
+// fits levels scrolling along x, where boxes are spread out along the sweep axis
+///////////////////////////////////////////////////
+
+class SweepAndPrune {
+private:
+	struct SortEntry {
+		float minX;
+		int box;
+	};
+
+	// keys of the sorted boxes at the last query, and the state of every key
+	std::vector<int> order;
+	std::vector<int> boxOfKey;
+	std::vector<int> frameOfKey;
+	std::vector<bool> isKeyInOrder;
+	int frame = 0;
+
+	std::vector<SortEntry> sortEntries;
+
+	// bounds in sorted order, padded with boxes that overlap nothing
+	std::vector<float> minX;
+	std::vector<float> maxX;
+	std::vector<float> minY;
+	std::vector<float> maxY;
+	std::vector<uint32_t> layerBits;
+	std::vector<uint32_t> masks;
+	std::vector<int> sortedBoxes;
+	int numTests = 0;
+
+	void Sort(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, const std::vector<int>& keys);
+	void Sweep(std::vector<CollisionPair>& pairs);
+
+public:
+	// appends every overlapping pair of boxes whose filters interact, ordered by first then second index
+	// keys identify boxes across frames, ie: entity ids, and must be unique and not negative
+	void FindOverlappingPairs(const std::vector<CollisionBox>& boxes, const std::vector<CollisionFilter>& filters, const std::vector<int>& keys, std::vector<CollisionPair>& pairs);
+
+	// box pairs within each other's x range in the last query, including pairs of ignored layers
+	int GetNumTests() const;
+
+	void Clear();
+};
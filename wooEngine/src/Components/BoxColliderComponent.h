@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../Collision/CollisionBox.h"
 #include <glm/glm.hpp>
 
 struct BoxColliderComponent {
@@ -7,10 +8,15 @@ public:
 	int width;
 	int height;
 	glm::vec2 offset;
+	// collision layer, ie: CollisionLayers::Intern("projectiles"), and the layers it collides with
+	int layer;
+	uint32_t mask;
 
-	BoxColliderComponent(int width = 0, int height = 0, glm::vec2 offset = glm::vec2(0)) {
+	BoxColliderComponent(int width = 0, int height = 0, glm::vec2 offset = glm::vec2(0), int layer = DEFAULT_COLLISION_LAYER, uint32_t mask = COLLISION_MASK_ALL) {
 		this->width = width;
 		this->height = height;
 		this->offset = offset;
+		this->layer = layer;
+		this->mask = mask;
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../ECS/ECS.h"
+#include <vector>
+
+// direct children of an entity, maintained by HierarchySystem from the children's ParentComponents
+struct ChildrenComponent {
+	std::vector<Entity> children;
+};
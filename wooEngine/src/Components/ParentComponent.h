@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../ECS/ECS.h"
+#include <glm/glm.hpp>
+
+// attaches an entity to a parent, the entity's TransformComponent then holds its world transform
+// computed by HierarchySystem from the parent's world transform and the local transform below
+// change the local transform with Patch so the subtree is recomputed
+struct ParentComponent {
+	Entity parent;
+	glm::vec2 localPosition;
+	glm::vec2 localScale;
+	double localRotation;
+
+	ParentComponent(Entity parent = Entity(ENTITY_INDEX_MASK), glm::vec2 localPosition = glm::vec2(0, 0), glm::vec2 localScale = glm::vec2(1, 1), double localRotation = 0.0) : parent(parent) {
+		this->localPosition = localPosition;
+		this->localScale = localScale;
+		this->localRotation = localRotation;
+	}
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+// marks a collider that never moves, it is baked into the collision system's static tree
+// and only tested against moving colliders
+struct StaticBodyComponent {
+	StaticBodyComponent() = default;
+};
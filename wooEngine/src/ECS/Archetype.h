@@ -0,0 +1,443 @@
+#pragma once
+
+// Archetype storage backend, included by ECS.h when WOO_ECS_ARCHETYPE_STORAGE is defined
+// do not include directly, it relies on Entity, Signature and Component<T> from ECS.h
+
+#include <cstddef>
+#include <new>
+#include <unordered_map>
+
+///////////////////////////////////////////////////
+// Archetype
+///////////////////////////////////////////////////
+// entities with the same signature live together in fixed size chunks
+// inside a chunk every component type has its own column (SoA), so systems
+// touching several components walk parallel arrays instead of unrelated pools
+///////////////////////////////////////////////////
+
+const size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+// type erased operations needed to move components between archetypes
+struct ComponentTypeInfo {
+	size_t size;
+	size_t alignment;
+	void (*moveConstruct)(void* destination, void* source);
+	void (*destroy)(void* component);
+};
+
+template <typename T>
+const ComponentTypeInfo* GetComponentTypeInfo() {
+	static const ComponentTypeInfo info = {
+		sizeof(T),
+		alignof(T),
+		[](void* destination, void* source) { new (destination) T(std::move(*static_cast<T*>(source))); },
+		[](void* component) { static_cast<T*>(component)->~T(); }
+	};
+	return &info;
+}
+
+struct alignas(64) Chunk {
+	unsigned char data[ARCHETYPE_CHUNK_SIZE];
+	int count = 0;
+};
+
+class Archetype {
+private:
+	Signature signature;
+	int chunkCapacity;
+
+	// one column per component type, sorted by component id
+	std::vector<int> componentIds;
+	std::vector<const ComponentTypeInfo*> columnTypes;
+	std::vector<size_t> columnOffsets;
+
+	// component id -> column index, -1 if the archetype lacks the component
+	std::vector<int> columnOfComponent;
+
+	std::vector<std::unique_ptr<Chunk>> chunks;
+
+	// cached transitions to the archetype with one component added or removed
+	// vector index = component id
+	std::vector<Archetype*> addEdges;
+	std::vector<Archetype*> removeEdges;
+
+	size_t ComputeLayout(int capacity) {
+		// the entity handles of a chunk are stored first, followed by one column per component
+		size_t offset = sizeof(Entity) * capacity;
+		for (size_t i = 0; i < columnTypes.size(); i++) {
+			const size_t alignment = columnTypes[i]->alignment;
+			offset = (offset + alignment - 1) / alignment * alignment;
+			columnOffsets[i] = offset;
+			offset += columnTypes[i]->size * capacity;
+		}
+		return offset;
+	}
+
+public:
+	Archetype(const Signature& signature, const std::vector<const ComponentTypeInfo*>& componentTypes) : signature(signature) {
+		columnOfComponent.resize(MAX_COMPONENTS, -1);
+		addEdges.resize(MAX_COMPONENTS, nullptr);
+		removeEdges.resize(MAX_COMPONENTS, nullptr);
+
+		size_t rowSize = sizeof(Entity);
+		for (int componentId = 0; componentId < static_cast<int>(MAX_COMPONENTS); componentId++) {
+			if (signature.test(componentId)) {
+				columnOfComponent[componentId] = static_cast<int>(componentIds.size());
+				componentIds.push_back(componentId);
+				columnTypes.push_back(componentTypes[componentId]);
+				rowSize += componentTypes[componentId]->size;
+			}
+		}
+		columnOffsets.resize(columnTypes.size());
+
+		// shrink the capacity until the padded layout fits in a chunk
+		chunkCapacity = static_cast<int>(ARCHETYPE_CHUNK_SIZE / rowSize);
+		while (chunkCapacity > 1 && ComputeLayout(chunkCapacity) > ARCHETYPE_CHUNK_SIZE) {
+			chunkCapacity--;
+		}
+		ComputeLayout(chunkCapacity);
+	}
+
+	const Signature& GetSignature() const {
+		return signature;
+	}
+
+	int GetNumChunks() const {
+		return static_cast<int>(chunks.size());
+	}
+
+	Chunk& GetChunk(int chunkIndex) const {
+		return *chunks[chunkIndex];
+	}
+
+	int GetSize() const {
+		return chunks.empty() ? 0 : (static_cast<int>(chunks.size()) - 1) * chunkCapacity + chunks.back()->count;
+	}
+
+	Entity* GetEntities(Chunk& chunk) const {
+		return reinterpret_cast<Entity*>(chunk.data);
+	}
+
+	void* GetComponent(Chunk& chunk, int column, int row) const {
+		return chunk.data + columnOffsets[column] + columnTypes[column]->size * row;
+	}
+
+	template <typename T>
+	T* GetColumn(Chunk& chunk) const {
+		const int column = columnOfComponent[Component<T>::GetId()];
+		return reinterpret_cast<T*>(chunk.data + columnOffsets[column]);
+	}
+
+	int GetColumnIndex(int componentId) const {
+		return columnOfComponent[componentId];
+	}
+
+	const std::vector<int>& GetComponentIds() const {
+		return componentIds;
+	}
+
+	Archetype*& AddEdge(int componentId) {
+		return addEdges[componentId];
+	}
+
+	Archetype*& RemoveEdge(int componentId) {
+		return removeEdges[componentId];
+	}
+
+	// reserves an uninitialized row at the end of the archetype, components must be constructed by the caller
+	void AllocateRow(Entity entity, int& chunkIndex, int& row) {
+		if (chunks.empty() || chunks.back()->count == chunkCapacity) {
+			chunks.push_back(std::make_unique<Chunk>());
+		}
+		chunkIndex = static_cast<int>(chunks.size()) - 1;
+		Chunk& chunk = *chunks.back();
+		row = chunk.count++;
+		new (GetEntities(chunk) + row) Entity(entity);
+	}
+
+	// removes a row whose components were already destroyed or moved out
+	// the last row of the archetype is moved into the hole, returns the entity that moved (or the removed one)
+	Entity FreeRow(int chunkIndex, int row) {
+		Chunk& chunk = *chunks[chunkIndex];
+		Chunk& lastChunk = *chunks.back();
+		const int lastRow = lastChunk.count - 1;
+		Entity movedEntity = GetEntities(lastChunk)[lastRow];
+
+		if (&chunk != &lastChunk || row != lastRow) {
+			for (size_t column = 0; column < columnTypes.size(); column++) {
+				void* last = GetComponent(lastChunk, static_cast<int>(column), lastRow);
+				columnTypes[column]->moveConstruct(GetComponent(chunk, static_cast<int>(column), row), last);
+				columnTypes[column]->destroy(last);
+			}
+			GetEntities(chunk)[row] = movedEntity;
+		}
+
+		lastChunk.count--;
+		if (lastChunk.count == 0) {
+			chunks.pop_back();
+		}
+		return movedEntity;
+	}
+
+	void DestroyRow(int chunkIndex, int row) {
+		Chunk& chunk = *chunks[chunkIndex];
+		for (size_t column = 0; column < columnTypes.size(); column++) {
+			columnTypes[column]->destroy(GetComponent(chunk, static_cast<int>(column), row));
+		}
+	}
+
+	~Archetype() {
+		for (int chunkIndex = 0; chunkIndex < GetNumChunks(); chunkIndex++) {
+			for (int row = 0; row < chunks[chunkIndex]->count; row++) {
+				DestroyRow(chunkIndex, row);
+			}
+		}
+	}
+};
+
+///////////////////////////////////////////////////
+// ArchetypeStorage
+///////////////////////////////////////////////////
+// owns every archetype and tracks where each entity's row lives
+///////////////////////////////////////////////////
+
+class ArchetypeStorage {
+private:
+	struct EntityLocation {
+		Archetype* archetype = nullptr;
+		int chunk = 0;
+		int row = 0;
+	};
+
+	std::unordered_map<Signature, std::unique_ptr<Archetype>> archetypesBySignature;
+	std::vector<Archetype*> archetypes;
+
+	// vector index = component id
+	std::vector<const ComponentTypeInfo*> componentTypes;
+
+	// vector index = entity id
+	std::vector<EntityLocation> entityLocations;
+
+	Archetype* GetOrCreateArchetype(const Signature& signature) {
+		auto archetype = archetypesBySignature.find(signature);
+		if (archetype != archetypesBySignature.end()) {
+			return archetype->second.get();
+		}
+
+		auto newArchetype = std::make_unique<Archetype>(signature, componentTypes);
+		Archetype* result = newArchetype.get();
+		archetypesBySignature.emplace(signature, std::move(newArchetype));
+		archetypes.push_back(result);
+		return result;
+	}
+
+	EntityLocation& GetLocation(int entityId) {
+		if (entityId >= static_cast<int>(entityLocations.size())) {
+			entityLocations.resize(entityId + 1);
+		}
+		return entityLocations[entityId];
+	}
+
+	// moves an entity's row into another archetype, constructing nothing for components the target adds
+	// and destroying components the target lacks
+	void MoveEntity(Entity entity, Archetype* target) {
+		EntityLocation& location = GetLocation(entity.GetId());
+		Archetype* source = location.archetype;
+
+		int targetChunk = 0;
+		int targetRow = 0;
+		if (target) {
+			target->AllocateRow(entity, targetChunk, targetRow);
+		}
+
+		if (source) {
+			Chunk& sourceChunk = source->GetChunk(location.chunk);
+			const auto& sourceComponentIds = source->GetComponentIds();
+
+			for (size_t column = 0; column < sourceComponentIds.size(); column++) {
+				void* component = source->GetComponent(sourceChunk, static_cast<int>(column), location.row);
+				const ComponentTypeInfo* type = componentTypes[sourceComponentIds[column]];
+				const int targetColumn = target ? target->GetColumnIndex(sourceComponentIds[column]) : -1;
+
+				if (targetColumn != -1) {
+					type->moveConstruct(target->GetComponent(target->GetChunk(targetChunk), targetColumn, targetRow), component);
+				}
+				type->destroy(component);
+			}
+
+			const Entity movedEntity = source->FreeRow(location.chunk, location.row);
+			if (movedEntity != entity) {
+				EntityLocation& movedLocation = entityLocations[movedEntity.GetId()];
+				movedLocation.chunk = location.chunk;
+				movedLocation.row = location.row;
+			}
+		}
+
+		location.archetype = target;
+		location.chunk = targetChunk;
+		location.row = targetRow;
+	}
+
+public:
+	ArchetypeStorage() = default;
+	~ArchetypeStorage() = default;
+
+	const std::vector<Archetype*>& GetArchetypes() const {
+		return archetypes;
+	}
+
+	// archetypes can only be created once the types of all their components are known
+	template <typename T>
+	void RegisterType() {
+		const int componentId = Component<T>::GetId();
+		if (componentId >= static_cast<int>(componentTypes.size())) {
+			componentTypes.resize(componentId + 1, nullptr);
+		}
+		componentTypes[componentId] = GetComponentTypeInfo<T>();
+	}
+
+	// places entities without components in the archetype of the signature in one step
+	// every column of the new rows is left unconstructed, each must be filled with Construct
+	void AllocateRows(const Entity* entities, int count, const Signature& signature) {
+		if (count <= 0 || signature.none()) {
+			return;
+		}
+
+		Archetype* target = GetOrCreateArchetype(signature);
+		for (int i = 0; i < count; i++) {
+			EntityLocation& location = GetLocation(entities[i].GetId());
+			location.archetype = target;
+			target->AllocateRow(entities[i], location.chunk, location.row);
+		}
+	}
+
+	template <typename T>
+	void Construct(Entity entity, const T& object) {
+		const EntityLocation& location = entityLocations[entity.GetId()];
+		Archetype* archetype = location.archetype;
+		const int column = archetype->GetColumnIndex(Component<T>::GetId());
+		new (archetype->GetComponent(archetype->GetChunk(location.chunk), column, location.row)) T(object);
+	}
+
+	template <typename T>
+	void Set(Entity entity, T object) {
+		const int componentId = Component<T>::GetId();
+		RegisterType<T>();
+
+		EntityLocation& location = GetLocation(entity.GetId());
+		if (location.archetype && location.archetype->GetSignature().test(componentId)) {
+			// if element exists already, replace it
+			Get<T>(entity) = std::move(object);
+			return;
+		}
+
+		Archetype* target = nullptr;
+		if (location.archetype) {
+			Archetype*& edge = location.archetype->AddEdge(componentId);
+			if (!edge) {
+				Signature signature = location.archetype->GetSignature();
+				signature.set(componentId);
+				edge = GetOrCreateArchetype(signature);
+			}
+			target = edge;
+		}
+		else {
+			Signature signature;
+			signature.set(componentId);
+			target = GetOrCreateArchetype(signature);
+		}
+
+		MoveEntity(entity, target);
+
+		const int column = target->GetColumnIndex(componentId);
+		new (target->GetComponent(target->GetChunk(location.chunk), column, location.row)) T(std::move(object));
+	}
+
+	void Remove(Entity entity, int componentId) {
+		EntityLocation& location = GetLocation(entity.GetId());
+		if (!location.archetype || !location.archetype->GetSignature().test(componentId)) {
+			return;
+		}
+
+		Archetype*& edge = location.archetype->RemoveEdge(componentId);
+		if (!edge) {
+			Signature signature = location.archetype->GetSignature();
+			signature.set(componentId, false);
+			edge = signature.none() ? nullptr : GetOrCreateArchetype(signature);
+		}
+
+		MoveEntity(entity, edge);
+	}
+
+	void RemoveEntity(Entity entity) {
+		if (static_cast<size_t>(entity.GetId()) < entityLocations.size() && entityLocations[entity.GetId()].archetype) {
+			MoveEntity(entity, nullptr);
+		}
+	}
+
+	template <typename T>
+	T& Get(Entity entity) const {
+		const EntityLocation& location = entityLocations[entity.GetId()];
+		Archetype* archetype = location.archetype;
+		const int column = archetype->GetColumnIndex(Component<T>::GetId());
+		return *static_cast<T*>(archetype->GetComponent(archetype->GetChunk(location.chunk), column, location.row));
+	}
+};
+
+///////////////////////////////////////////////////
+// ComponentView (archetype storage)
+///////////////////////////////////////////////////
+// visits every archetype whose signature contains the requested components
+// and walks the matching columns of each chunk in lockstep
+///////////////////////////////////////////////////
+
+template <typename ...TComponents>
+class ComponentView {
+private:
+	ArchetypeStorage* storage;
+	Signature signature;
+
+public:
+	ComponentView(ArchetypeStorage* storage) : storage(storage) {
+		(signature.set(Component<TComponents>::GetId()), ...);
+	}
+
+	// callback signature: void(Entity, TComponents&...)
+	// components must not be added to or removed from visited entities inside the callback
+	template <typename TFunc>
+	void Each(TFunc func) const {
+		const auto& archetypes = storage->GetArchetypes();
+
+		for (size_t i = 0; i < archetypes.size(); i++) {
+			const Archetype* archetype = archetypes[i];
+			if (!archetype->GetSignature().Contains(signature)) {
+				continue;
+			}
+
+			for (int chunkIndex = 0; chunkIndex < archetype->GetNumChunks(); chunkIndex++) {
+				Chunk& chunk = archetype->GetChunk(chunkIndex);
+				const Entity* entities = archetype->GetEntities(chunk);
+				auto columns = std::make_tuple(archetype->template GetColumn<TComponents>(chunk)...);
+
+				for (int row = 0; row < chunk.count; row++) {
+					std::apply([&func, entities, row](auto* ...column) { func(entities[row], column[row]...); }, columns);
+				}
+			}
+		}
+	}
+
+	// same as Each but the matching chunks are distributed over the registry thread pool
+	// the callback may only write the visited components, structural changes are buffered per chunk
+	template <typename TFunc> void ParallelEach(TFunc func) const;
+
+	// upper bound on the number of entities visited
+	int SizeHint() const {
+		int size = 0;
+		for (const Archetype* archetype : storage->GetArchetypes()) {
+			if (archetype->GetSignature().Contains(signature)) {
+				size += archetype->GetSize();
+			}
+		}
+		return size;
+	}
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// registration list of the engine's component types
+// a component's id is its index in this list, so ids are known at compile time and
+// identical across runs and processes. append new types at the end to keep existing ids stable
+// types missing from the list (ie: mods) get an id after the registered ones on first use
+
+struct TransformComponent;
+struct RigidBodyComponent;
+struct SpriteComponent;
+struct AnimationComponent;
+struct BoxColliderComponent;
+struct KeyboardControllerComponent;
+struct CameraFollowComponent;
+struct HealthComponent;
+struct ProjectileEmitterComponent;
+struct ProjectileComponent;
+struct TextLabelComponent;
+struct ScriptComponent;
+struct ParentComponent;
+struct ChildrenComponent;
+struct StaticBodyComponent;
+
+template <typename ...TComponents>
+struct ComponentList {
+	static constexpr int size = sizeof...(TComponents);
+};
+
+typedef ComponentList<
+	TransformComponent,
+	RigidBodyComponent,
+	SpriteComponent,
+	AnimationComponent,
+	BoxColliderComponent,
+	KeyboardControllerComponent,
+	CameraFollowComponent,
+	HealthComponent,
+	ProjectileEmitterComponent,
+	ProjectileComponent,
+	TextLabelComponent,
+	ScriptComponent,
+	ParentComponent,
+	ChildrenComponent,
+	StaticBodyComponent
+> EngineComponents;
@@ -1,13 +1,41 @@
 #include "ECS.h"
 #include "../Logger/Logger.h"
 #include <string>
+#include <cstring>
+#include <cstdlib>
 
-int IComponent::nextId = 0;
+std::atomic<int> IComponent::nextId = EngineComponents::size;
 
-int Entity::GetId() const {
+int IComponent::AssignUnregisteredId() {
+	const int id = nextId++;
+	if (id >= static_cast<int>(MAX_COMPONENTS)) {
+		// an out of range id would index past every signature bitset
+		Logger::Err("Component limit reached, raise MAX_COMPONENTS or register the component type in ComponentTypes.h.");
+		std::abort();
+	}
 	return id;
 }
 
+Registry* Entity::registry = nullptr;
+
+thread_local CommandBuffer* CommandBuffer::active = nullptr;
+
+int Entity::GetId() const {
+	return static_cast<int>(handle & ENTITY_INDEX_MASK);
+}
+
+uint32_t Entity::GetGeneration() const {
+	return handle >> ENTITY_INDEX_BITS;
+}
+
+uint32_t Entity::GetHandle() const {
+	return handle;
+}
+
+bool Entity::IsAlive() const {
+	return registry->IsAlive(*this);
+}
+
 void Entity::Kill() {
 	registry->KillEntity(*this);
 }
@@ -16,30 +44,76 @@ void Entity::Tag(const std::string& tag) {
 	registry->TagEntity(*this, tag);
 }
 
+void Entity::Tag(int tag) {
+	registry->TagEntity(*this, tag);
+}
+
 bool Entity::HasTag(const std::string& tag) const {
 	return registry->EntityHasTag(*this, tag);
 }
 
+bool Entity::HasTag(int tag) const {
+	return registry->EntityHasTag(*this, tag);
+}
+
 void Entity::Group(const std::string& group) {
 	registry->GroupEntity(*this, group);
 }
 
+void Entity::Group(int group) {
+	registry->GroupEntity(*this, group);
+}
+
 bool Entity::BelongsToGroup(const std::string& group) const {
 	return registry->EntityBelongsToGroup(*this, group);
 }
 
-void System::AddEntityToSystem(Entity entity) {
-	entities.push_back(entity);
+bool Entity::BelongsToGroup(int group) const {
+	return registry->EntityBelongsToGroup(*this, group);
 }
 
+void System::AddEntityToSystem(Entity entity) {
+	const auto entityId = entity.GetId();
+	if (entityId >= static_cast<int>(entityPositions.size())) {
+		entityPositions.resize(entityId + 1, -1);
+	}
+
+	if (entityPositions[entityId] == -1) {
+		entityPositions[entityId] = static_cast<int>(entities.size());
+		entities.push_back(entity);
+	}
+}
 
 void System::RemoveEntityFromSystem(Entity entity) {
-	entities.erase(std::remove_if(entities.begin(), entities.end(), [&entity](Entity other) {
-		return entity == other;
-		}), entities.end());
+	if (!HasEntity(entity)) {
+		return;
+	}
+
+	// move last entity into the removed position
+	const auto entityId = entity.GetId();
+	const int position = entityPositions[entityId];
+	const Entity lastEntity = entities.back();
+
+	entities[position] = lastEntity;
+	entityPositions[lastEntity.GetId()] = position;
+
+	entities.pop_back();
+	entityPositions[entityId] = -1;
 }
 
-std::vector<Entity> System::GetSystemEntities() const {
+void System::RemoveAllEntities() {
+	for (auto entity : entities) {
+		entityPositions[entity.GetId()] = -1;
+	}
+	entities.clear();
+}
+
+bool System::HasEntity(Entity entity) const {
+	const auto entityId = entity.GetId();
+	return entityId < static_cast<int>(entityPositions.size()) && entityPositions[entityId] != -1;
+}
+
+const std::vector<Entity>& System::GetSystemEntities() const {
 	return entities;
 }
 
@@ -51,133 +125,676 @@ const Signature& System::GetComponentSignature() const {
 	return componentSignature;
 }
 
-Entity Registry::CreateEntity() {
-	int entityId;
-	
-	if (freeIds.empty()) {
-		entityId = numEntities++;
+const Signature& System::GetExcludeSignature() const {
+	return excludeSignature;
+}
+
+bool System::Matches(const Signature& entityComponentSignature) const {
+	return entityComponentSignature.Contains(componentSignature) && (entityComponentSignature & excludeSignature).none();
+}
+
+void System::SetExclusive() {
+	isExclusive = true;
+}
+
+const Signature& System::GetReadSignature() const {
+	return readSignature;
+}
+
+const Signature& System::GetWriteSignature() const {
+	return writeSignature;
+}
+
+bool System::IsExclusive() const {
+	return isExclusive;
+}
+
+bool ICommand::Resolve(Registry& registry, Entity& entity) {
+	if (entity.GetGeneration() != ENTITY_PLACEHOLDER_GENERATION) {
+		return true;
+	}
+
+	auto created = registry.entityOfPlaceholder.find(entity.GetHandle());
+	if (created == registry.entityOfPlaceholder.end()) {
+		Logger::Err("Command refers to an entity that was not created by an earlier command.");
+		return false;
+	}
+	entity = created->second;
+	return true;
+}
+
+void CreateEntityCommand::Execute(Registry& registry) {
+	registry.BindPlaceholder(entity, registry.CreateEntity());
+}
+
+void KillEntityCommand::Execute(Registry& registry) {
+	if (Resolve(registry, entity)) {
+		registry.KillEntity(entity);
+	}
+}
+
+void TagEntityCommand::Execute(Registry& registry) {
+	if (Resolve(registry, entity)) {
+		registry.TagEntity(entity, tag);
+	}
+}
+
+void GroupEntityCommand::Execute(Registry& registry) {
+	if (Resolve(registry, entity)) {
+		registry.GroupEntity(entity, group);
+	}
+}
+
+void InstantiateCommand::Execute(Registry& registry) {
+	std::vector<Entity> created;
+	registry.ReserveEntities(static_cast<int>(entities.size()), created);
+	registry.SyncReservedEntities();
+	for (size_t i = 0; i < entities.size(); i++) {
+		registry.BindPlaceholder(entities[i], created[i]);
+	}
+	registry.InstantiateReserved(prefab, created, initFunc);
+}
+
+Entity CommandBuffer::CreateEntity() {
+	Entity entity = registry->CreatePlaceholder();
+	commands.push_back(std::make_unique<CreateEntityCommand>(entity));
+	return entity;
+}
+
+void CommandBuffer::KillEntity(Entity entity) {
+	commands.push_back(std::make_unique<KillEntityCommand>(entity));
+}
+
+void CommandBuffer::TagEntity(Entity entity, int tag) {
+	commands.push_back(std::make_unique<TagEntityCommand>(entity, tag));
+}
+
+void CommandBuffer::GroupEntity(Entity entity, int group) {
+	commands.push_back(std::make_unique<GroupEntityCommand>(entity, group));
+}
+
+void CommandBuffer::Instantiate(const Prefab& prefab, std::vector<Entity>&& entities, PrefabInitFunc&& initFunc) {
+	commands.push_back(std::make_unique<InstantiateCommand>(prefab, std::move(entities), std::move(initFunc)));
+}
+
+void CommandBuffer::MarkPatched(Entity entity, int componentId) {
+	patches.emplace_back(entity, componentId);
+}
+
+void CommandBuffer::Append(CommandBuffer& other) {
+	for (auto& command : other.commands) {
+		commands.push_back(std::move(command));
+	}
+	other.commands.clear();
+	patches.insert(patches.end(), other.patches.begin(), other.patches.end());
+	other.patches.clear();
+}
+
+void CommandBuffer::Playback() {
+	// commands are applied directly even if playback happens inside a scope
+	CommandBuffer* previous = active;
+	active = nullptr;
+
+	// patches were written before any recorded command was applied, so none targets a placeholder
+	for (const auto& patch : patches) {
+		registry->OnComponentPatched(patch.first, patch.second);
+	}
+	patches.clear();
+
+	for (auto& command : commands) {
+		command->Execute(*registry);
+	}
+	commands.clear();
+
+	active = previous;
+}
+
+Entity Registry::ReserveEntity() {
+	const int reservation = numReservedEntities.fetch_add(1);
+	const int numFreeIds = static_cast<int>(freeIds.size());
+
+	if (reservation < numFreeIds) {
+		// reuse previously removed entity id, its generation was bumped when it was freed
+		const int entityId = freeIds[reservation];
+		return Entity(entityId, entityGenerations[entityId]);
+	}
+
+	const int entityId = numEntities + (reservation - numFreeIds);
+	if (static_cast<uint32_t>(entityId) > ENTITY_INDEX_MASK) {
+		// the handle would mask the index down onto a live entity
+		Logger::Err("Entity limit reached, cannot create entity.");
+		std::abort();
+	}
+	return Entity(entityId, 0);
+}
+
+void Registry::ReserveEntities(int count, std::vector<Entity>& entities) {
+	// one atomic add claims a contiguous range of reservations
+	const int firstReservation = numReservedEntities.fetch_add(count);
+	const int numFreeIds = static_cast<int>(freeIds.size());
+
+	const int numNewIds = std::max(0, firstReservation + count - numFreeIds);
+	if (static_cast<uint32_t>(numEntities + numNewIds) > ENTITY_INDEX_MASK + 1) {
+		Logger::Err("Entity limit reached, cannot create entity.");
+		std::abort();
+	}
 
-		if (entityId >= entityComponentSignatures.size()) {
-			entityComponentSignatures.resize(entityId + 1);
+	entities.reserve(entities.size() + count);
+	for (int reservation = firstReservation; reservation < firstReservation + count; reservation++) {
+		if (reservation < numFreeIds) {
+			const int entityId = freeIds[reservation];
+			entities.push_back(Entity(entityId, entityGenerations[entityId]));
+		}
+		else {
+			entities.push_back(Entity(numEntities + (reservation - numFreeIds), 0));
 		}
 	}
-	else {
-		// reuse previously removed entity id
-		entityId = freeIds.front();
-		freeIds.pop_front();
+}
+
+Entity Registry::CreatePlaceholder() {
+	return Entity(nextPlaceholder.fetch_add(1) & ENTITY_INDEX_MASK, ENTITY_PLACEHOLDER_GENERATION);
+}
+
+void Registry::CreatePlaceholders(int count, std::vector<Entity>& entities) {
+	const uint32_t first = nextPlaceholder.fetch_add(count);
+	entities.reserve(entities.size() + count);
+	for (uint32_t i = 0; i < static_cast<uint32_t>(count); i++) {
+		entities.push_back(Entity((first + i) & ENTITY_INDEX_MASK, ENTITY_PLACEHOLDER_GENERATION));
 	}
+}
 
-	Entity entity(entityId);
-	entity.registry = this;
-	entitiesToBeAdded.insert(entity);
+void Registry::BindPlaceholder(Entity placeholder, Entity entity) {
+	entityOfPlaceholder.insert_or_assign(placeholder.GetHandle(), entity);
+}
+
+void Registry::SyncReservedEntities() {
+	const int numReserved = numReservedEntities.exchange(0);
+	const int numReused = std::min(numReserved, static_cast<int>(freeIds.size()));
+
+	freeIds.erase(freeIds.begin(), freeIds.begin() + numReused);
+	numEntities += numReserved - numReused;
 
-	Logger::Log("Entity created with id = " + std::to_string(entityId));
+	if (numEntities > static_cast<int>(entityComponentSignatures.size())) {
+		entityComponentSignatures.resize(numEntities);
+		entitySystemSignatures.resize(numEntities);
+		entityComponentsToBeRemoved.resize(numEntities);
+		entityRefreshPending.resize(numEntities, false);
+		entityGenerations.resize(numEntities, 0);
+		tagPerEntity.resize(numEntities, -1);
+		entityGroupMasks.resize(numEntities, 0);
+	}
+}
+
+CommandBuffer& Registry::CreateCommandBuffer() {
+	commandBuffers.push_back(std::make_unique<CommandBuffer>(this));
+	return *commandBuffers.back();
+}
+
+void Registry::SetThreadPool(ThreadPool* threadPool) {
+	this->threadPool = threadPool;
+}
+
+Entity Registry::CreateEntity() {
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		return buffer->CreateEntity();
+	}
+
+	Entity entity = ReserveEntity();
+	SyncReservedEntities();
+	MarkEntityForRefresh(entity);
+
+	WOO_LOG_DEBUG("Entity created with id = " + std::to_string(entity.GetId()));
 
 	return entity;
 }
 
+void Registry::Instantiate(const Prefab& prefab, int count, PrefabInitFunc initFunc) {
+	if (count <= 0) {
+		return;
+	}
+
+	std::vector<Entity> entities;
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		CreatePlaceholders(count, entities);
+		buffer->Instantiate(prefab, std::move(entities), std::move(initFunc));
+		return;
+	}
+
+	ReserveEntities(count, entities);
+	SyncReservedEntities();
+	InstantiateReserved(prefab, entities, initFunc);
+}
+
+Entity Registry::Instantiate(const Prefab& prefab) {
+	std::vector<Entity> entities;
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		CreatePlaceholders(1, entities);
+		const Entity placeholder = entities[0];
+		buffer->Instantiate(prefab, std::move(entities), nullptr);
+		return placeholder;
+	}
+
+	ReserveEntities(1, entities);
+	const Entity entity = entities[0];
+	SyncReservedEntities();
+	InstantiateReserved(prefab, entities, nullptr);
+	return entity;
+}
+
+void Registry::InstantiateReserved(const Prefab& prefab, const std::vector<Entity>& entities, const PrefabInitFunc& initFunc) {
+	const int count = static_cast<int>(entities.size());
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	// rows are allocated once in the prefab's archetype instead of moving archetype once per component
+	// every component is constructed before observers run, so they never see a partly built row
+	for (const auto& component : prefab.GetComponents()) {
+		component->RegisterType(archetypeStorage);
+	}
+	archetypeStorage.AllocateRows(entities.data(), count, prefab.GetSignature());
+	for (const auto& component : prefab.GetComponents()) {
+		component->Construct(archetypeStorage, entities.data(), count);
+	}
+	for (const auto& component : prefab.GetComponents()) {
+		OnComponentsAdded(component->GetComponentId(), entities.data(), count);
+	}
+#else
+	for (const auto& component : prefab.GetComponents()) {
+		component->Instantiate(*this, entities.data(), count);
+	}
+#endif
+
+	for (int group : prefab.GetGroups()) {
+		for (auto entity : entities) {
+			GroupEntity(entity, group);
+		}
+	}
+
+	prefabBatches.push_back({ prefab.GetSignature(), entities });
+
+	if (initFunc) {
+		for (int i = 0; i < count; i++) {
+			initFunc(entities[i], i);
+		}
+	}
+}
+
+void Registry::OnComponentsAdded(int componentId, const Entity* entities, int count) {
+	for (int i = 0; i < count; i++) {
+		entityComponentSignatures[entities[i].GetId()].set(componentId);
+		entityComponentsToBeRemoved[entities[i].GetId()].set(componentId, false);
+	}
+
+	if (ComponentObservers* observers = FindObservers(componentId)) {
+		for (int i = 0; i < count; i++) {
+			observers->Notify(observers->onConstruct, entities[i]);
+		}
+	}
+}
+
+void Registry::OnComponentPatched(Entity entity, int componentId) {
+	ComponentObservers& observers = GetObservers(componentId);
+	observers.MarkChanged(entity);
+	observers.Notify(observers.onUpdate, entity);
+}
+
+void Registry::SetPrefab(const std::string& name, const Prefab& prefab) {
+	prefabs.insert_or_assign(name, prefab);
+}
+
+const Prefab* Registry::FindPrefab(const std::string& name) const {
+	auto prefab = prefabs.find(name);
+	return prefab != prefabs.end() ? &prefab->second : nullptr;
+}
+
+Prefab& Prefab::Group(const std::string& group) {
+	return Group(Registry::InternGroup(group));
+}
+
 void Registry::KillEntity(Entity entity) {
-	entitiesToBeKilled.insert(entity);
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->KillEntity(entity);
+		return;
+	}
+
+	// ignore stale handles so a kill can never reach the entity reusing the id
+	if (IsAlive(entity)) {
+		entitiesToBeKilled.insert(entity);
+	}
+}
+
+bool Registry::IsAlive(Entity entity) const {
+	const auto entityId = entity.GetId();
+	return static_cast<size_t>(entityId) < entityGenerations.size() && entityGenerations[entityId] == entity.GetGeneration();
+}
+
+ComponentObservers& Registry::GetObservers(int componentId) {
+	if (componentId >= static_cast<int>(componentObservers.size())) {
+		componentObservers.resize(componentId + 1);
+	}
+	if (!componentObservers[componentId]) {
+		componentObservers[componentId] = std::make_unique<ComponentObservers>();
+	}
+	return *componentObservers[componentId];
 }
 
-void Registry::AddEntityToSystems(Entity entity) {
+void Registry::MarkEntityForRefresh(Entity entity) {
 	const auto entityId = entity.GetId();
+	if (!entityRefreshPending[entityId]) {
+		entityRefreshPending[entityId] = true;
+		entitiesToBeRefreshed.push_back(entity);
+	}
+}
+
+void Registry::RemoveComponentData(Entity entity, int componentId) {
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	archetypeStorage.Remove(entity, componentId);
+#else
+	if (IGroup* group = GetGroupOwner(componentId)) {
+		group->OnComponentRemoving(entity);
+	}
+	componentPools[componentId]->RemoveEntityFromPool(entity.GetId());
+#endif
+}
+
+void Registry::RefreshPendingEntities() {
+	// entities of a batch share a signature, so matching systems are found once per batch
+	for (const auto& batch : prefabBatches) {
+		for (auto& system : systems) {
+			if (system.second->Matches(batch.signature)) {
+				for (auto entity : batch.entities) {
+					system.second->AddEntityToSystem(entity);
+				}
+			}
+		}
+		for (auto entity : batch.entities) {
+			entitySystemSignatures[entity.GetId()] = batch.signature;
+		}
+	}
+	prefabBatches.clear();
+
+	// re-evaluate membership of entities created or changed one by one, after the batches
+	// so changes made by prefab init functions are diffed against the prefab signature
+	for (auto entity : entitiesToBeRefreshed) {
+		RefreshEntityInSystems(entity);
+	}
+	entitiesToBeRefreshed.clear();
+}
+
+void Registry::RefreshEntityInSystems(Entity entity) {
+	const auto entityId = entity.GetId();
+	entityRefreshPending[entityId] = false;
+
+	// release data of components removed since the last update
+	auto& componentsToBeRemoved = entityComponentsToBeRemoved[entityId];
+	if (componentsToBeRemoved.any()) {
+		for (unsigned int componentId = 0; componentId < MAX_COMPONENTS; componentId++) {
+			if (componentsToBeRemoved.test(componentId)) {
+				RemoveComponentData(entity, componentId);
+			}
+		}
+		componentsToBeRemoved.reset();
+	}
+
 	const auto& entityComponentSignature = entityComponentSignatures[entityId];
+	auto& entitySystemSignature = entitySystemSignatures[entityId];
+	const Signature changedComponents = entityComponentSignature ^ entitySystemSignature;
 
-	//check every system for one that matches signatures
 	for (auto& system : systems) {
 		const auto& systemComponentSignature = system.second->GetComponentSignature();
 
-		bool componentsMatch = (entityComponentSignature & systemComponentSignature) == systemComponentSignature;	//check bitsets with bitwise AND
+		// membership can only change for systems requiring or excluding a changed component
+		// systems requiring nothing match every entity and are always checked
+		if ((changedComponents & (systemComponentSignature | system.second->GetExcludeSignature())).none() && systemComponentSignature.any()) {
+			continue;
+		}
+
+		bool componentsMatch = system.second->Matches(entityComponentSignature);
 
 		if (componentsMatch) {
 			system.second->AddEntityToSystem(entity);
 		}
+		else {
+			system.second->RemoveEntityFromSystem(entity);
+		}
 	}
+
+	entitySystemSignature = entityComponentSignature;
 }
 
 void Registry::RemoveEntityFromSystems(Entity entity) {
-	//check every system for one that matches signatures
+	const auto entityId = entity.GetId();
+	const auto& entityComponentSignature = entitySystemSignatures[entityId];
+
+	// only systems whose signature the entity matched can hold it
 	for (auto& system : systems) {
-		system.second->RemoveEntityFromSystem(entity);
+		if (system.second->Matches(entityComponentSignature)) {
+			system.second->RemoveEntityFromSystem(entity);
+		}
+	}
+}
+
+// name interning
+SymbolTable Registry::tagSymbols;
+SymbolTable Registry::groupSymbols;
+
+int SymbolTable::Intern(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto symbol = ids.find(name);
+	if (symbol != ids.end()) {
+		return symbol->second;
 	}
+
+	const int id = static_cast<int>(names.size());
+	ids.emplace(name, id);
+	names.push_back(name);
+	return id;
+}
+
+int SymbolTable::Find(const std::string& name) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto symbol = ids.find(name);
+	return symbol != ids.end() ? symbol->second : -1;
+}
+
+std::string SymbolTable::GetName(int id) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return names[id];
+}
+
+int SymbolTable::GetSize() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<int>(names.size());
+}
+
+int Registry::InternTag(const std::string& tag) {
+	return tagSymbols.Intern(tag);
+}
+
+int Registry::InternGroup(const std::string& group) {
+	const int id = groupSymbols.Intern(group);
+	if (id >= MAX_GROUPS) {
+		Logger::Err("Group limit reached, cannot create group " + group + ".");
+	}
+	return id;
+}
+
+int Registry::FindTag(const std::string& tag) {
+	return tagSymbols.Find(tag);
+}
+
+int Registry::FindGroup(const std::string& group) {
+	return groupSymbols.Find(group);
+}
+
+std::string Registry::GetGroupName(int group) {
+	return groupSymbols.GetName(group);
 }
 
 // tag management
 void Registry::TagEntity(Entity entity, const std::string& tag) {
-	entityPerTag.emplace(tag, entity);
-	tagPerEntity.emplace(entity.GetId(), tag);
+	TagEntity(entity, InternTag(tag));
 }
 
-bool Registry::EntityHasTag(Entity entity, const std::string& tag) const {
-	if (tagPerEntity.find(entity.GetId()) == tagPerEntity.end()) {
-		return false;
+void Registry::TagEntity(Entity entity, int tag) {
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->TagEntity(entity, tag);
+		return;
 	}
-	return entityPerTag.find(tag)->second == entity;
+
+	// a tag names a single entity and an entity has a single tag
+	RemoveEntityTag(entity);
+	auto previousEntity = entityPerTag.find(tag);
+	if (previousEntity != entityPerTag.end()) {
+		tagPerEntity[previousEntity->second.GetId()] = -1;
+	}
+
+	entityPerTag.insert_or_assign(tag, entity);
+	tagPerEntity[entity.GetId()] = tag;
+}
+
+bool Registry::EntityHasTag(Entity entity, const std::string& tag) const {
+	return EntityHasTag(entity, FindTag(tag));
+}
+
+bool Registry::EntityHasTag(Entity entity, int tag) const {
+	return tag >= 0 && IsAlive(entity) && tagPerEntity[entity.GetId()] == tag;
 }
 
 Entity Registry::GetEntityByTag(const std::string& tag) const {
+	return GetEntityByTag(FindTag(tag));
+}
+
+Entity Registry::GetEntityByTag(int tag) const {
 	return entityPerTag.at(tag);
 }
 
 void Registry::RemoveEntityTag(Entity entity) {
-	auto taggedEntity = tagPerEntity.find(entity.GetId());
-	if (taggedEntity != tagPerEntity.end()) {
-		auto tag = taggedEntity->second;
+	const int tag = tagPerEntity[entity.GetId()];
+	if (tag != -1) {
 		entityPerTag.erase(tag);
-		tagPerEntity.erase(taggedEntity);
+		tagPerEntity[entity.GetId()] = -1;
 	}
 }
 
 //group management
 void Registry::GroupEntity(Entity entity, const std::string& group) {
-	entitiesPerGroup.emplace(group, std::set<Entity>());
-	entitiesPerGroup[group].emplace(entity);
-	groupPerEntity.emplace(entity.GetId(), group);
+	GroupEntity(entity, InternGroup(group));
 }
 
-bool Registry::EntityBelongsToGroup(Entity entity, const std::string& group) const {
-	if (entitiesPerGroup.find(group) == entitiesPerGroup.end()) {
-		return false;
+void Registry::GroupEntity(Entity entity, int group) {
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->GroupEntity(entity, group);
+		return;
 	}
 
-	auto groupEntities = entitiesPerGroup.at(group);
-	return groupEntities.find(entity.GetId()) != groupEntities.end();
+	if (group >= MAX_GROUPS) {
+		return;
+	}
+
+	const auto entityId = entity.GetId();
+	const uint64_t groupBit = uint64_t(1) << group;
+	if (entityGroupMasks[entityId] & groupBit) {
+		return;
+	}
+	entityGroupMasks[entityId] |= groupBit;
+
+	if (group >= static_cast<int>(entitiesPerGroup.size())) {
+		entitiesPerGroup.resize(group + 1);
+	}
+	auto& members = entitiesPerGroup[group];
+	if (entityId >= static_cast<int>(members.positions.size())) {
+		members.positions.resize(entityId + 1, -1);
+	}
+	members.positions[entityId] = static_cast<int>(members.entities.size());
+	members.entities.push_back(entity);
 }
 
-std::vector<Entity> Registry::GetEntitiesByGroup(const std::string& group) const {
-	auto& setOfEntities = entitiesPerGroup.at(group);
-	return std::vector<Entity>(setOfEntities.begin(), setOfEntities.end());
+bool Registry::EntityBelongsToGroup(Entity entity, const std::string& group) const {
+	return EntityBelongsToGroup(entity, FindGroup(group));
 }
 
-void Registry::RemoveEntityGroup(Entity entity) {
-	// check if entity is in group and remove if so
-	auto groupedEntity = groupPerEntity.find(entity.GetId());
-	if (groupedEntity != groupPerEntity.end()) {
-		auto group = entitiesPerGroup.find(groupedEntity->second);
-		if (group != entitiesPerGroup.end()) {
-			auto entityInGroup = group->second.find(entity);
-			if (entityInGroup != group->second.end()) {
-				group->second.erase(entityInGroup);
-			}
-		}
-		groupPerEntity.erase(groupedEntity);
+bool Registry::EntityBelongsToGroup(Entity entity, int group) const {
+	return group >= 0 && group < MAX_GROUPS && IsAlive(entity) && ((entityGroupMasks[entity.GetId()] >> group) & 1);
+}
+
+const std::vector<Entity>& Registry::GetEntitiesByGroup(const std::string& group) const {
+	return GetEntitiesByGroup(FindGroup(group));
+}
+
+const std::vector<Entity>& Registry::GetEntitiesByGroup(int group) const {
+	static const std::vector<Entity> noEntities;
+	return group >= 0 && group < static_cast<int>(entitiesPerGroup.size()) ? entitiesPerGroup[group].entities : noEntities;
+}
+
+void Registry::RemoveEntityFromGroup(Entity entity, int group) {
+	const auto entityId = entity.GetId();
+	const uint64_t groupBit = uint64_t(1) << group;
+	if (group >= MAX_GROUPS || !(entityGroupMasks[entityId] & groupBit)) {
+		return;
+	}
+	entityGroupMasks[entityId] &= ~groupBit;
+
+	// move last member into the removed position
+	auto& members = entitiesPerGroup[group];
+	const int position = members.positions[entityId];
+	const Entity lastEntity = members.entities.back();
+
+	members.entities[position] = lastEntity;
+	members.positions[lastEntity.GetId()] = position;
+
+	members.entities.pop_back();
+	members.positions[entityId] = -1;
+}
+
+void Registry::RemoveEntityGroups(Entity entity) {
+	for (int group = 0; entityGroupMasks[entity.GetId()] != 0; group++) {
+		RemoveEntityFromGroup(entity, group);
 	}
 }
 
 void Registry::Update() {
-	// Add entities that are waiting
-	for (auto entity : entitiesToBeAdded) {
-		AddEntityToSystems(entity);
+	// sync point: apply command buffers in a stable order, entities they create get ids in that order
+	SyncReservedEntities();
+	for (auto& buffer : commandBuffers) {
+		buffer->Playback();
 	}
-	entitiesToBeAdded.clear();
+	entityOfPlaceholder.clear();
+
+	// changed lists cover one frame, from this update to the next, once the buffered patches are in
+	for (auto& observers : componentObservers) {
+		if (observers) {
+			observers->SwapChanged();
+		}
+	}
+
+	// add new entities to systems and re-evaluate membership of entities whose signature changed
+	RefreshPendingEntities();
 
 	//remove similarly, updating freeIds for new entities to reuse later
 	for (auto entity : entitiesToBeKilled) {
 		RemoveEntityFromSystems(entity);
+
+		// notify destroy observers while the components are still in storage
+		for (unsigned int componentId = 0; componentId < componentObservers.size(); componentId++) {
+			if (componentObservers[componentId] && entityComponentSignatures[entity.GetId()].test(componentId)) {
+				componentObservers[componentId]->Notify(componentObservers[componentId]->onDestroy, entity);
+			}
+		}
+
 		entityComponentSignatures[entity.GetId()].reset();
+		entitySystemSignatures[entity.GetId()].reset();
+		entityComponentsToBeRemoved[entity.GetId()].reset();
+
+		WOO_LOG_DEBUG("Entity id = " + std::to_string(entity.GetId()) + " was killed.");
 
-		//Logger::Log("Entity id = " + std::to_string(entity.GetId()) + " was killed.");
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+		// destroy entity's row in its archetype
+		archetypeStorage.RemoveEntity(entity);
+#else
+		// unpack entity from owning groups before the pools swap-and-pop it
+		for (auto& group : groups) {
+			group.second->OnComponentRemoving(entity);
+		}
 
 		// remove entity from component pools
 		for (auto pool : componentPools) {
@@ -186,11 +803,330 @@ void Registry::Update() {
 				pool->RemoveEntityFromPool(entity.GetId());
 			}
 		}
+#endif
 
+		// invalidate outstanding handles before the id can be reused
+		uint32_t generation = (entity.GetGeneration() + 1) & ENTITY_GENERATION_MASK;
+		if (generation == ENTITY_PLACEHOLDER_GENERATION) {
+			generation = 0;
+		}
+		entityGenerations[entity.GetId()] = generation;
 		freeIds.push_back(entity.GetId());
 
 		RemoveEntityTag(entity);
-		RemoveEntityGroup(entity);
+		RemoveEntityGroups(entity);
 	}
 	entitiesToBeKilled.clear();
-}
\ No newline at end of file
+}
+
+// pool memory
+void Registry::Compact() {
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	// pools grow by doubling, a quarter keeps a wave of entities from shrinking and regrowing a pool every time
+	for (auto pool : componentPools) {
+		if (pool) {
+			const PoolStats stats = pool->GetStats();
+			const int keptCapacity = std::max(POOL_DEFAULT_CAPACITY, stats.reservedCapacity);
+			if (stats.capacity > keptCapacity && stats.size < stats.capacity / 4) {
+				pool->ShrinkToFit();
+			}
+		}
+	}
+#endif
+}
+
+std::vector<PoolStats> Registry::GetPoolStats() const {
+	std::vector<PoolStats> poolStats;
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	for (auto pool : componentPools) {
+		if (pool) {
+			poolStats.push_back(pool->GetStats());
+		}
+	}
+#endif
+	return poolStats;
+}
+
+// snapshots
+void Registry::ClearEntities() {
+	// pending commands refer to entities that are about to disappear
+	for (auto& buffer : commandBuffers) {
+		buffer->Clear();
+	}
+	numReservedEntities = 0;
+	entityOfPlaceholder.clear();
+
+	entitiesToBeKilled.clear();
+	entitiesToBeRefreshed.clear();
+	prefabBatches.clear();
+
+	for (auto& system : systems) {
+		system.second->RemoveAllEntities();
+	}
+
+	for (auto& observers : componentObservers) {
+		if (observers) {
+			observers->ClearChanged();
+		}
+	}
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	std::vector<bool> isFree(numEntities, false);
+	for (int entityId : freeIds) {
+		isFree[entityId] = true;
+	}
+	for (int entityId = 0; entityId < numEntities; entityId++) {
+		if (!isFree[entityId]) {
+			archetypeStorage.RemoveEntity(Entity(entityId, entityGenerations[entityId]));
+		}
+	}
+#else
+	for (auto pool : componentPools) {
+		if (pool) {
+			pool->Clear();
+		}
+	}
+	for (auto& group : groups) {
+		group.second->Rebuild();
+	}
+#endif
+
+	numEntities = 0;
+	freeIds.clear();
+	entityComponentSignatures.clear();
+	entitySystemSignatures.clear();
+	entityComponentsToBeRemoved.clear();
+	entityRefreshPending.clear();
+	entityGenerations.clear();
+
+	entityPerTag.clear();
+	tagPerEntity.clear();
+	entityGroupMasks.clear();
+	entitiesPerGroup.clear();
+}
+
+bool Registry::SaveSnapshot([[maybe_unused]] const std::string& path) {
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	Logger::Err("Snapshots are not supported by the archetype storage.");
+	return false;
+#else
+	// release data of components removed this frame so pools hold exactly what signatures say
+	RefreshPendingEntities();
+
+	Signature savedComponents;
+	std::vector<int> savedComponentIds;
+	for (int componentId = 0; componentId < static_cast<int>(componentSerializers.size()); componentId++) {
+		if (componentSerializers[componentId] && componentId < static_cast<int>(componentPools.size()) && componentPools[componentId]) {
+			savedComponents.set(componentId);
+			savedComponentIds.push_back(componentId);
+		}
+	}
+
+	SnapshotHeader header = {};
+	std::memcpy(header.magic, "WOOS", sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.signatureSize = sizeof(Signature);
+	header.numEntities = numEntities;
+	header.numFreeIds = static_cast<uint32_t>(freeIds.size());
+	header.numTagNames = tagSymbols.GetSize();
+	header.numGroupNames = groupSymbols.GetSize();
+	header.numComponentBlocks = static_cast<uint32_t>(savedComponentIds.size());
+
+	SnapshotWriter writer;
+	writer.Write(header);
+
+	// entity tables
+	std::vector<Signature> savedSignatures(numEntities);
+	for (int entityId = 0; entityId < numEntities; entityId++) {
+		savedSignatures[entityId] = entityComponentSignatures[entityId] & savedComponents;
+	}
+	const std::vector<int> savedFreeIds(freeIds.begin(), freeIds.end());
+
+	writer.WriteArray(entityGenerations.data(), numEntities);
+	writer.WriteArray(savedSignatures.data(), numEntities);
+	writer.WriteArray(savedFreeIds.data(), savedFreeIds.size());
+	writer.WriteArray(tagPerEntity.data(), numEntities);
+	writer.WriteArray(entityGroupMasks.data(), numEntities);
+
+	// tag and group ids depend on interning order, names let the loader map them to its own ids
+	for (unsigned int tag = 0; tag < header.numTagNames; tag++) {
+		writer.WriteString(tagSymbols.GetName(tag));
+	}
+	for (unsigned int group = 0; group < header.numGroupNames; group++) {
+		writer.WriteString(groupSymbols.GetName(group));
+	}
+
+	for (int componentId : savedComponentIds) {
+		writer.Align();
+		componentSerializers[componentId]->Save(componentId, *componentPools[componentId], writer);
+	}
+
+	if (!writer.SaveToFile(path)) {
+		Logger::Err("Could not write snapshot " + path + ".");
+		return false;
+	}
+
+	Logger::Log("Snapshot of " + std::to_string(numEntities - freeIds.size()) + " entities saved to " + path + ".");
+	return true;
+#endif
+}
+
+bool Registry::LoadSnapshot([[maybe_unused]] const std::string& path) {
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	Logger::Err("Snapshots are not supported by the archetype storage.");
+	return false;
+#else
+	MappedFile file;
+	if (!file.Open(path)) {
+		Logger::Err("Could not open snapshot " + path + ".");
+		return false;
+	}
+	SnapshotReader reader(file.GetData(), file.GetSize());
+
+	SnapshotHeader header;
+	if (!reader.Read(header) || std::memcmp(header.magic, "WOOS", sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+		header.signatureSize != sizeof(Signature) || header.numEntities > ENTITY_INDEX_MASK + 1) {
+		Logger::Err("File " + path + " is not a snapshot of this engine version.");
+		return false;
+	}
+
+	// entity tables point straight into the mapped file
+	const int numSavedEntities = static_cast<int>(header.numEntities);
+	const uint32_t* savedGenerations = reader.ReadArray<uint32_t>(numSavedEntities);
+	const Signature* savedSignatures = reader.ReadArray<Signature>(numSavedEntities);
+	const int* savedFreeIds = reader.ReadArray<int>(header.numFreeIds);
+	const int* savedTags = reader.ReadArray<int>(numSavedEntities);
+	const uint64_t* savedGroupMasks = reader.ReadArray<uint64_t>(numSavedEntities);
+
+	std::vector<std::string> tagNames(header.numTagNames);
+	std::vector<std::string> groupNames(header.numGroupNames);
+	for (auto& name : tagNames) {
+		reader.ReadString(name);
+	}
+	for (auto& name : groupNames) {
+		reader.ReadString(name);
+	}
+
+	// locate every block before touching the registry so a truncated file leaves the world intact
+	struct Block {
+		SnapshotBlockHeader header;
+		const Entity* entities;
+		const char* data;
+	};
+	std::vector<Block> blocks(header.numComponentBlocks);
+	for (auto& block : blocks) {
+		reader.Align();
+		reader.Read(block.header);
+		block.entities = reader.ReadArray<Entity>(block.header.numComponents);
+		reader.Align();
+		block.data = reader.ReadBytes(block.header.dataSize);
+	}
+
+	if (reader.HasFailed()) {
+		Logger::Err("Snapshot " + path + " is truncated.");
+		return false;
+	}
+
+	std::vector<bool> isFree(numSavedEntities, false);
+	bool isValid = true;
+	for (unsigned int i = 0; i < header.numFreeIds; i++) {
+		isValid = isValid && savedFreeIds[i] >= 0 && savedFreeIds[i] < numSavedEntities && !isFree[savedFreeIds[i]];
+		if (isValid) {
+			isFree[savedFreeIds[i]] = true;
+		}
+	}
+	for (int entityId = 0; entityId < numSavedEntities; entityId++) {
+		isValid = isValid && savedTags[entityId] >= -1 && savedTags[entityId] < static_cast<int>(header.numTagNames);
+		isValid = isValid && (header.numGroupNames >= 64 || (savedGroupMasks[entityId] >> header.numGroupNames) == 0);
+	}
+	// blocks must hold exactly one entry per signature bit, pools trust signatures from here on
+	std::vector<Signature> blockSignatures(numSavedEntities);
+	for (const auto& block : blocks) {
+		const int componentId = block.header.componentId;
+		isValid = isValid && componentId >= 0 && componentId < static_cast<int>(MAX_COMPONENTS);
+		for (unsigned int i = 0; i < block.header.numComponents && isValid; i++) {
+			const int entityId = block.entities[i].GetId();
+			isValid = entityId < numSavedEntities && !isFree[entityId] && savedSignatures[entityId].test(componentId) && !blockSignatures[entityId].test(componentId);
+			if (isValid) {
+				blockSignatures[entityId].set(componentId);
+			}
+		}
+	}
+	for (int entityId = 0; entityId < numSavedEntities && isValid; entityId++) {
+		isValid = blockSignatures[entityId] == savedSignatures[entityId];
+	}
+	if (!isValid) {
+		Logger::Err("Snapshot " + path + " is corrupted.");
+		return false;
+	}
+
+	ClearEntities();
+
+	numEntities = numSavedEntities;
+	entityGenerations.assign(savedGenerations, savedGenerations + numSavedEntities);
+	entityComponentSignatures.assign(savedSignatures, savedSignatures + numSavedEntities);
+	entitySystemSignatures.assign(numSavedEntities, Signature());
+	entityComponentsToBeRemoved.assign(numSavedEntities, Signature());
+	entityRefreshPending.assign(numSavedEntities, false);
+	tagPerEntity.assign(numSavedEntities, -1);
+	entityGroupMasks.assign(numSavedEntities, 0);
+	freeIds.assign(savedFreeIds, savedFreeIds + header.numFreeIds);
+
+	// component pools, one copy per raw block
+	for (const auto& block : blocks) {
+		const int componentId = block.header.componentId;
+		IComponentSerializer* serializer = (componentId >= 0 && componentId < static_cast<int>(componentSerializers.size())) ? componentSerializers[componentId].get() : nullptr;
+
+		SnapshotReader blockReader(block.data, block.header.dataSize);
+		if (serializer && serializer->Load(block.header, block.entities, blockReader, *componentPools[componentId])) {
+			continue;
+		}
+
+		// keep signatures in line with storage when a block cannot be restored
+		Logger::Err("Snapshot component id = " + std::to_string(componentId) + " could not be restored.");
+		if (serializer) {
+			componentPools[componentId]->Clear();
+		}
+		for (int entityId = 0; entityId < numSavedEntities && componentId >= 0 && componentId < static_cast<int>(MAX_COMPONENTS); entityId++) {
+			entityComponentSignatures[entityId].set(componentId, false);
+		}
+	}
+
+	for (auto& group : groups) {
+		group.second->Rebuild();
+	}
+
+	// tags, groups and system membership of alive entities
+	std::vector<int> tagIds;
+	std::vector<int> groupIds;
+	for (const auto& name : tagNames) {
+		tagIds.push_back(InternTag(name));
+	}
+	for (const auto& name : groupNames) {
+		groupIds.push_back(InternGroup(name));
+	}
+
+	int numAliveEntities = 0;
+	for (int entityId = 0; entityId < numSavedEntities; entityId++) {
+		if (isFree[entityId]) {
+			continue;
+		}
+
+		const Entity entity(entityId, entityGenerations[entityId]);
+		if (savedTags[entityId] != -1) {
+			TagEntity(entity, tagIds[savedTags[entityId]]);
+		}
+		for (int group = 0; group < static_cast<int>(groupIds.size()); group++) {
+			if ((savedGroupMasks[entityId] >> group) & 1) {
+				GroupEntity(entity, groupIds[group]);
+			}
+		}
+
+		RefreshEntityInSystems(entity);
+		numAliveEntities++;
+	}
+
+	Logger::Log("Snapshot of " + std::to_string(numAliveEntities) + " entities loaded from " + path + ".");
+	return true;
+#endif
+}
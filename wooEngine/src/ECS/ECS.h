@@ -1,74 +1,230 @@
 #pragma once
 
 #include "../Logger/Logger.h"
+#include "../Scheduler/ThreadPool.h"
+#include "ComponentTypes.h"
+#include "Snapshot.h"
 
-#include <bitset>
+#include <array>
+#include <type_traits>
+#include <cstdint>
 #include <vector>
 #include <unordered_map>
 #include <typeindex>
 #include <set>
 #include <deque>
 #include <memory>
+#include <algorithm>
+#include <tuple>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <string>
 
-const unsigned int MAX_COMPONENTS = 32;
+const unsigned int MAX_COMPONENTS = 128;
+
+// parallel loops split dense arrays at multiples of this many elements, so each
+// chunk spans several cache lines and neighbouring threads can only meet on the
+// line at a chunk boundary, dense arrays themselves are not cache line aligned
+const int PARALLEL_CHUNK_ALIGNMENT = 64;
+
+// group membership is stored as one bit per group
+const int MAX_GROUPS = 64;
 
 ///////////////////////////////////////////////////
 // Signature
 ///////////////////////////////////////////////////
 // a bitset to keep track of which components an entity has
 // and which entities a given system is interested in
+// stored as 64 bit words so set operations compile to a few (vectorized) word operations
+// keeps the subset of the std::bitset interface used by the engine
 ///////////////////////////////////////////////////
 
-typedef std::bitset<MAX_COMPONENTS> Signature;
+class Signature {
+private:
+	static const int NUM_WORDS = (MAX_COMPONENTS + 63) / 64;
+	std::array<uint64_t, NUM_WORDS> words = {};
+
+public:
+	void set(size_t bit, bool value = true) {
+		const uint64_t mask = uint64_t(1) << (bit % 64);
+		words[bit / 64] = value ? (words[bit / 64] | mask) : (words[bit / 64] & ~mask);
+	}
+
+	bool test(size_t bit) const {
+		return (words[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	void reset() {
+		words.fill(0);
+	}
+
+	bool any() const {
+		uint64_t bits = 0;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			bits |= words[i];
+		}
+		return bits != 0;
+	}
+
+	bool none() const {
+		return !any();
+	}
+
+	// true if every bit set in other is also set here
+	bool Contains(const Signature& other) const {
+		uint64_t missing = 0;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			missing |= other.words[i] & ~words[i];
+		}
+		return missing == 0;
+	}
+
+	Signature operator &(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] & other.words[i];
+		}
+		return result;
+	}
+
+	Signature operator |(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] | other.words[i];
+		}
+		return result;
+	}
+
+	Signature operator ^(const Signature& other) const {
+		Signature result;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			result.words[i] = words[i] ^ other.words[i];
+		}
+		return result;
+	}
+
+	bool operator ==(const Signature& other) const { return words == other.words; };
+	bool operator !=(const Signature& other) const { return words != other.words; };
+
+	size_t Hash() const {
+		size_t hash = 0;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			hash = hash * 31 + std::hash<uint64_t>()(words[i]);
+		}
+		return hash;
+	}
+};
+
+namespace std {
+	template <>
+	struct hash<Signature> {
+		size_t operator()(const Signature& signature) const {
+			return signature.Hash();
+		}
+	};
+}
+
+// index of T in a component list, -1 if T is not registered
+template <typename T, typename ...TComponents>
+constexpr int GetComponentListIndex(ComponentList<TComponents...>) {
+	constexpr bool matches[] = { false, std::is_same_v<T, TComponents>... };
+	for (int i = 1; i <= static_cast<int>(sizeof...(TComponents)); i++) {
+		if (matches[i]) {
+			return i - 1;
+		}
+	}
+	return -1;
+}
+
+static_assert(EngineComponents::size <= static_cast<int>(MAX_COMPONENTS), "MAX_COMPONENTS is smaller than the component registration list");
 
 // "interface component"
 struct IComponent {
 protected:
-	static int nextId;
+	// next id for component types missing from the registration list
+	static std::atomic<int> nextId;
+
+	static int AssignUnregisteredId();
 };
 
 // used to assign a unique id to a component type
 template <typename T>
 class Component: public IComponent {
 public:
+	// compile time id of registered types, -1 for unregistered ones
+	static constexpr int registeredId = GetComponentListIndex<T>(EngineComponents());
+
 	static int GetId() {
-		static auto id = nextId++;
-		return id;
+		if constexpr (registeredId != -1) {
+			return registeredId;
+		}
+		else {
+			static const int id = AssignUnregisteredId();
+			return id;
+		}
 	}
 };
 
+///////////////////////////////////////////////////
+// Entity
+///////////////////////////////////////////////////
+// an entity is a 32 bit handle packing an index (low bits) and a generation (high bits)
+// the index addresses pools and signatures, the generation is bumped whenever the index is
+// freed so handles captured before a kill can never alias the entity that reuses the index
+///////////////////////////////////////////////////
+
+const unsigned int ENTITY_INDEX_BITS = 20;
+const unsigned int ENTITY_GENERATION_BITS = 32 - ENTITY_INDEX_BITS;
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+const uint32_t ENTITY_GENERATION_MASK = (1u << ENTITY_GENERATION_BITS) - 1;
+
+// handles created inside a command buffer scope carry this generation until playback
+// gives them a real id, live entities skip it when their generation wraps
+const uint32_t ENTITY_PLACEHOLDER_GENERATION = ENTITY_GENERATION_MASK;
+
 class Entity {
 private:
-	int id;
+	uint32_t handle;
 public:
-	Entity(int id) : id(id) {};
+	explicit Entity(int id, uint32_t generation = 0) : handle((generation << ENTITY_INDEX_BITS) | (static_cast<uint32_t>(id) & ENTITY_INDEX_MASK)) {};
 	Entity(const Entity& entity) = default;
 	int GetId() const;
+	uint32_t GetGeneration() const;
+	uint32_t GetHandle() const;
+	bool IsAlive() const;
 
 	// manage tags and groups
+	// names are hashed on every call, hot paths should pass ids from Registry::InternTag / InternGroup
 	void Tag(const std::string& tag);
+	void Tag(int tag);
 	bool HasTag(const std::string& tag) const;
+	bool HasTag(int tag) const;
 	void Group(const std::string& group);
+	void Group(int group);
 	bool BelongsToGroup(const std::string& group) const;
+	bool BelongsToGroup(int group) const;
 
 	Entity& operator =(const Entity& other) = default;
-	bool operator ==(const Entity& other) const { return id == other.id; };
-	bool operator !=(const Entity& other) const { return id != other.id; };
-	bool operator >(const Entity& other) const { return id > other.id; };
-	bool operator <(const Entity& other) const { return id < other.id; };
-	bool operator >=(const Entity& other) const { return id >= other.id; };
-	bool operator <=(const Entity& other) const { return id <= other.id; };
+	bool operator ==(const Entity& other) const { return handle == other.handle; };
+	bool operator !=(const Entity& other) const { return handle != other.handle; };
+	bool operator >(const Entity& other) const { return handle > other.handle; };
+	bool operator <(const Entity& other) const { return handle < other.handle; };
+	bool operator >=(const Entity& other) const { return handle >= other.handle; };
+	bool operator <=(const Entity& other) const { return handle <= other.handle; };
 
 	template <typename TComponent, typename ...TArgs> void AddComponent(TArgs&& ...args);
 	template <typename TComponent> void RemoveComponent();
 	template <typename TComponent> bool HasComponent() const;
 	template <typename TComponent> TComponent& GetComponent() const;
+	template <typename TComponent, typename TFunc> void Patch(TFunc func);
 
 	void Kill();
 
-	// reference to entity's registry
+	// the registry that owns all entities, set when the registry is constructed
 	// used to allow function calls (kill, component management) on entity object instead of directly from registry
-	class Registry* registry;
+	// kept static so that an entity stays a single 32 bit handle
+	static class Registry* registry;
 };
 
 ///////////////////////////////////////////////////
@@ -81,126 +237,1036 @@ class System {
 private:
 	// which components an entity must have for system to consider the entity
 	Signature componentSignature;
+	// which components an entity must not have
+	Signature excludeSignature;
 	std::vector<Entity> entities;
 
+	// position of each entity in entities, -1 if the entity is not in the system
+	// vector index = entity id
+	std::vector<int> entityPositions;
+
+	// components the system update reads and writes, used by the scheduler to run systems in parallel
+	Signature readSignature;
+	Signature writeSignature;
+	bool isExclusive = false;
+
 public:
 	System() = default;
 	~System() = default;
 
 	void AddEntityToSystem(Entity entity);
 	void RemoveEntityFromSystem(Entity entity);
-	std::vector<Entity> GetSystemEntities() const;
+	void RemoveAllEntities();
+	bool HasEntity(Entity entity) const;
+	const std::vector<Entity>& GetSystemEntities() const;
 	int GetNumEntities() const;
 	const Signature& GetComponentSignature() const;
+	const Signature& GetExcludeSignature() const;
+
+	// true if an entity with these components belongs to the system
+	bool Matches(const Signature& entityComponentSignature) const;
 
 	// defines which kinds of components entities must have to be considered by system
 	template <typename TComponent> void RequireComponent();
+
+	// entities with this component are left out, ie: static colliders from the collision system
+	template <typename TComponent> void ExcludeComponent();
+
+	// declares the component access of the system update
+	template <typename TComponent> void Reads();
+	template <typename TComponent> void Writes();
+
+	// the system touches state outside of components (event bus, lua, ...) and must run alone
+	void SetExclusive();
+
+	const Signature& GetReadSignature() const;
+	const Signature& GetWriteSignature() const;
+	bool IsExclusive() const;
 };
 
 ///////////////////////////////////////////////////
 // Pool
 ///////////////////////////////////////////////////
-// A pool is a vector of objects of type T
+// A pool is a sparse set of objects of type T
+// components are packed contiguously in a dense vector, a paged sparse array
+// maps an entity id to its dense index so lookups are two array reads
 ///////////////////////////////////////////////////
+
+// number of entity ids covered by one page of a pool's sparse array
+const int POOL_PAGE_SIZE = 4096;
+
+// capacity of a pool's dense arrays when it is created, unless reserved otherwise
+const int POOL_DEFAULT_CAPACITY = 100;
+
+// algorithm used to sort a pool
+// insertion takes the out of order elements out and merges them back in, which is
+// linear on nearly sorted data, ie: a pool re-sorted every frame
+enum SortAlgorithm {
+	SORT_DEFAULT,
+	SORT_INSERTION
+};
+
+// memory used by a pool, for the debug gui
+struct PoolStats {
+	std::string name;
+	int size;
+	int capacity;
+	// capacity requested with Reserve, shrinking keeps at least this much
+	int reservedCapacity;
+	// dense arrays and sparse pages, not counting memory owned by the components themselves
+	size_t bytes;
+	// times the dense arrays were reallocated to grow
+	int numGrowths;
+	int numSparsePages;
+};
+
 class IPool {
 public:
-	virtual ~IPool() {}
-	virtual void RemoveEntityFromPool(int entityId) = 0;
+	virtual ~IPool() {}
+	virtual void RemoveEntityFromPool(int entityId) = 0;
+	virtual void Clear() = 0;
+
+	// releases dense capacity beyond the reserved capacity and sparse pages without live entries
+	virtual void ShrinkToFit() = 0;
+	virtual PoolStats GetStats() const = 0;
+};
+
+template <typename T>
+class Pool: public IPool {
+private:
+	// dense arrays, data[i] belongs to entities[i]
+	std::vector<T> data;
+	std::vector<Entity> entities;
+
+	// sparse array split into pages allocated on demand, -1 marks an absent entity
+	std::vector<std::unique_ptr<int[]>> sparsePages;
+
+	int numGrowths = 0;
+	int reservedCapacity = 0;
+
+	// scratch space of Sort, kept to avoid allocating on every sort
+	std::vector<int> sortOrder;
+	std::vector<std::pair<T, Entity>> sortBuffer;
+
+	void MoveElement(int from, int to) {
+		data[to] = std::move(data[from]);
+		entities[to] = entities[from];
+		*GetSparseEntry(entities[to].GetId()) = to;
+	}
+
+	// reallocates the dense arrays to hold at least requiredSize components, at least doubling them
+	// vector growth move constructs the live components only, spare capacity stays unconstructed
+	void Grow(size_t requiredSize) {
+		data.reserve(std::max(requiredSize, data.capacity() * 2));
+		entities.reserve(data.capacity());
+		numGrowths++;
+	}
+
+	int* GetSparseEntry(int entityId) const {
+		const size_t page = entityId / POOL_PAGE_SIZE;
+		if (page >= sparsePages.size() || !sparsePages[page]) {
+			return nullptr;
+		}
+		return &sparsePages[page][entityId % POOL_PAGE_SIZE];
+	}
+
+	int& CreateSparseEntry(int entityId) {
+		const size_t page = entityId / POOL_PAGE_SIZE;
+		if (page >= sparsePages.size()) {
+			sparsePages.resize(page + 1);
+		}
+		if (!sparsePages[page]) {
+			sparsePages[page] = std::make_unique<int[]>(POOL_PAGE_SIZE);
+			std::fill(sparsePages[page].get(), sparsePages[page].get() + POOL_PAGE_SIZE, -1);
+		}
+		return sparsePages[page][entityId % POOL_PAGE_SIZE];
+	}
+
+	// reallocates a dense array to exactly capacity elements, moving the live ones
+	template <typename TElement>
+	static void ShrinkTo(std::vector<TElement>& elements, size_t capacity) {
+		if (elements.capacity() > capacity) {
+			std::vector<TElement> shrunk;
+			shrunk.reserve(capacity);
+			shrunk.insert(shrunk.end(), std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+			elements.swap(shrunk);
+		}
+	}
+
+public:
+	Pool(int capacity = POOL_DEFAULT_CAPACITY) {
+		data.reserve(capacity);
+		entities.reserve(capacity);
+	}
+
+	~Pool() = default;
+
+	bool IsEmpty() const {
+		return data.empty();
+	}
+
+	int GetSize() const {
+		return static_cast<int>(data.size());
+	}
+
+	void Clear() override {
+		data.clear();
+		entities.clear();
+		sparsePages.clear();
+	}
+
+	// grows the dense arrays once so the next additions up to capacity do not reallocate
+	// the capacity is remembered, so shrinking the pool later never goes below it
+	void Reserve(int capacity) {
+		reservedCapacity = std::max(reservedCapacity, capacity);
+		if (static_cast<size_t>(capacity) > data.capacity()) {
+			data.reserve(capacity);
+			entities.reserve(capacity);
+		}
+	}
+
+	// invalidates references to components of this pool
+	void ShrinkToFit() override {
+		const size_t capacity = std::max(data.size(), static_cast<size_t>(reservedCapacity));
+		ShrinkTo(data, capacity);
+		ShrinkTo(entities, capacity);
+
+		// free pages that no live entity maps into
+		std::vector<bool> isPageUsed(sparsePages.size(), false);
+		for (auto entity : entities) {
+			isPageUsed[entity.GetId() / POOL_PAGE_SIZE] = true;
+		}
+		for (size_t page = 0; page < sparsePages.size(); page++) {
+			if (!isPageUsed[page]) {
+				sparsePages[page].reset();
+			}
+		}
+		while (!sparsePages.empty() && !sparsePages.back()) {
+			sparsePages.pop_back();
+		}
+		sparsePages.shrink_to_fit();
+	}
+
+	int GetCapacity() const {
+		return static_cast<int>(data.capacity());
+	}
+
+	PoolStats GetStats() const override {
+		PoolStats stats;
+		stats.name = typeid(T).name();
+
+		// msvc prefixes type names with their kind
+		const std::string prefix = "struct ";
+		if (stats.name.compare(0, prefix.size(), prefix) == 0) {
+			stats.name.erase(0, prefix.size());
+		}
+
+		stats.size = GetSize();
+		stats.capacity = GetCapacity();
+		stats.reservedCapacity = reservedCapacity;
+		stats.numGrowths = numGrowths;
+		stats.numSparsePages = static_cast<int>(std::count_if(sparsePages.begin(), sparsePages.end(), [](const auto& page) { return page != nullptr; }));
+		stats.bytes = data.capacity() * sizeof(T) + entities.capacity() * sizeof(Entity) + sparsePages.capacity() * sizeof(sparsePages[0])
+			+ static_cast<size_t>(stats.numSparsePages) * POOL_PAGE_SIZE * sizeof(int);
+		return stats;
+	}
+
+	bool Has(int entityId) const {
+		const int* index = GetSparseEntry(entityId);
+		return index && *index != -1;
+	}
+
+	void Set(Entity entity, T object) {
+		int& index = CreateSparseEntry(entity.GetId());
+		if (index != -1) {
+			// if element exists already, replace it
+			data[index] = std::move(object);
+		}
+		else {
+			if (data.size() == data.capacity()) {
+				Grow(data.size() + 1);
+			}
+
+			// keep track of entity id and its dense index
+			index = static_cast<int>(data.size());
+			data.push_back(std::move(object));
+			entities.push_back(entity);
+		}
+	}
+
+	// sets the same component for several entities, growing the dense arrays once
+	void SetMany(const Entity* entities, int count, const T& object) {
+		const size_t requiredSize = data.size() + count;
+		if (requiredSize > data.capacity()) {
+			Grow(requiredSize);
+		}
+
+		for (int i = 0; i < count; i++) {
+			int& index = CreateSparseEntry(entities[i].GetId());
+			if (index != -1) {
+				data[index] = object;
+			}
+			else {
+				index = static_cast<int>(data.size());
+				data.push_back(object);
+				this->entities.push_back(entities[i]);
+			}
+		}
+	}
+
+	void Remove(int entityId) {
+		// move last element to deleted position for contiguity
+		int& indexOfRemoved = *GetSparseEntry(entityId);
+		const int indexOfLast = static_cast<int>(data.size()) - 1;
+		const Entity entityOfLastElement = entities[indexOfLast];
+
+		if (indexOfRemoved != indexOfLast) {
+			data[indexOfRemoved] = std::move(data[indexOfLast]);
+			entities[indexOfRemoved] = entityOfLastElement;
+			*GetSparseEntry(entityOfLastElement.GetId()) = indexOfRemoved;
+		}
+
+		data.pop_back();
+		entities.pop_back();
+		indexOfRemoved = -1;
+	}
+
+	void RemoveEntityFromPool(int entityId) override {
+		if (Has(entityId)) {
+			Remove(entityId);
+		}
+	}
+
+	T& Get(int entityId) {
+		return data[*GetSparseEntry(entityId)];
+	}
+
+	// dense index of an entity's component, -1 if absent
+	int GetIndex(int entityId) const {
+		const int* index = GetSparseEntry(entityId);
+		return index ? *index : -1;
+	}
+
+	// swaps two components in the dense arrays and fixes up their sparse entries
+	void Swap(int indexA, int indexB) {
+		if (indexA == indexB) {
+			return;
+		}
+		std::swap(data[indexA], data[indexB]);
+		std::swap(entities[indexA], entities[indexB]);
+		*GetSparseEntry(entities[indexA].GetId()) = indexA;
+		*GetSparseEntry(entities[indexB].GetId()) = indexB;
+	}
+
+	// returns nullptr if the entity has no component in this pool
+	T* TryGet(int entityId) {
+		const int* index = GetSparseEntry(entityId);
+		return (index && *index != -1) ? &data[*index] : nullptr;
+	}
+
+	// reorders the dense arrays so that compare(data[i], data[j]) is false for every i > j
+	// compare signature: bool(const T&, const T&)
+	template <typename TCompare>
+	void Sort(TCompare compare, SortAlgorithm algorithm) {
+		const int size = GetSize();
+
+		if (algorithm == SORT_INSERTION) {
+			// pull out both elements of every descent so the remaining elements stay in order
+			// at most twice the number of misplaced elements are pulled out
+			int numKept = 0;
+			for (int i = 0; i < size; i++) {
+				if (numKept > 0 && compare(data[i], data[numKept - 1])) {
+					numKept--;
+					sortBuffer.emplace_back(std::move(data[numKept]), entities[numKept]);
+					sortBuffer.emplace_back(std::move(data[i]), entities[i]);
+				}
+				else {
+					if (i != numKept) {
+						MoveElement(i, numKept);
+					}
+					numKept++;
+				}
+			}
+			if (sortBuffer.empty()) {
+				return;
+			}
+
+			// sort the few pulled out elements, then merge them back in from the end
+			std::stable_sort(sortBuffer.begin(), sortBuffer.end(), [&compare](const auto& a, const auto& b) { return compare(a.first, b.first); });
+			int kept = numKept - 1;
+			for (int target = size - 1, pulled = static_cast<int>(sortBuffer.size()) - 1; pulled >= 0; target--) {
+				if (kept >= 0 && compare(sortBuffer[pulled].first, data[kept])) {
+					MoveElement(kept, target);
+					kept--;
+				}
+				else {
+					data[target] = std::move(sortBuffer[pulled].first);
+					entities[target] = sortBuffer[pulled].second;
+					*GetSparseEntry(entities[target].GetId()) = target;
+					pulled--;
+				}
+			}
+			sortBuffer.clear();
+			return;
+		}
+
+		// sort the dense indices, then move every element once by following the cycles of the permutation
+		sortOrder.resize(size);
+		for (int i = 0; i < size; i++) {
+			sortOrder[i] = i;
+		}
+		std::sort(sortOrder.begin(), sortOrder.end(), [this, &compare](int a, int b) { return compare(data[a], data[b]); });
+
+		for (int i = 0; i < size; i++) {
+			if (sortOrder[i] == i) {
+				continue;
+			}
+
+			// slot current receives the element at sortOrder[current]
+			T object = std::move(data[i]);
+			const Entity entity = entities[i];
+			int current = i;
+			while (sortOrder[current] != i) {
+				const int next = sortOrder[current];
+				MoveElement(next, current);
+				sortOrder[current] = current;
+				current = next;
+			}
+
+			data[current] = std::move(object);
+			entities[current] = entity;
+			*GetSparseEntry(entity.GetId()) = current;
+			sortOrder[current] = current;
+		}
+	}
+
+	// entities owning a component, in the same order as the component data
+	const std::vector<Entity>& GetEntities() const {
+		return entities;
+	}
+
+	const std::vector<T>& GetData() const {
+		return data;
+	}
+
+	// replace the content of the pool, components[i] belongs to entities[i]
+	// the dense arrays are filled with one range copy (a memcpy for trivially copyable types)
+	template <typename TIterator>
+	void Assign(const Entity* entities, int count, TIterator components) {
+		Clear();
+		if (static_cast<size_t>(count) > data.capacity()) {
+			Grow(count);
+		}
+		this->entities.assign(entities, entities + count);
+		data.assign(components, components + count);
+		for (int i = 0; i < count; i++) {
+			CreateSparseEntry(entities[i].GetId()) = i;
+		}
+	}
+
+	T& operator [](unsigned int index) {
+		return data[index];
+	}
+};
+
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+#include "Archetype.h"
+#else
+
+///////////////////////////////////////////////////
+// ComponentView
+///////////////////////////////////////////////////
+// A view iterates every entity that has all of the given components
+// it walks the entities of the smallest pool and probes the others, handing
+// the callback direct references without copying entity lists
+// ie: registry->View<TransformComponent, RigidBodyComponent>().Each([](Entity entity, TransformComponent& transform, RigidBodyComponent& rigidbody) {...});
+///////////////////////////////////////////////////
+
+template <typename ...TComponents>
+class ComponentView {
+private:
+	std::tuple<Pool<TComponents>*...> pools;
+
+	const std::vector<Entity>& GetSmallestPoolEntities() const {
+		const std::vector<Entity>* smallest = nullptr;
+		std::apply([&smallest](auto* ...pool) {
+			((smallest = (!smallest || pool->GetEntities().size() < smallest->size()) ? &pool->GetEntities() : smallest), ...);
+		}, pools);
+		return *smallest;
+	}
+
+	template <typename TFunc>
+	void EachInRange(TFunc& func, const std::vector<Entity>& entities, int begin, int end) const {
+		for (int i = begin; i < end; i++) {
+			const Entity entity = entities[i];
+			const int entityId = entity.GetId();
+
+			auto components = std::make_tuple(std::get<Pool<TComponents>*>(pools)->TryGet(entityId)...);
+			const bool hasAllComponents = std::apply([](auto* ...component) { return ((component != nullptr) && ...); }, components);
+
+			if (hasAllComponents) {
+				std::apply([&func, entity](auto* ...component) { func(entity, *component...); }, components);
+			}
+		}
+	}
+
+public:
+	ComponentView(Pool<TComponents>* ...pools) : pools(pools...) {}
+
+	// callback signature: void(Entity, TComponents&...)
+	// components of the viewed types must not be added inside the callback
+	template <typename TFunc>
+	void Each(TFunc func) const {
+		const auto& entities = GetSmallestPoolEntities();
+		EachInRange(func, entities, 0, static_cast<int>(entities.size()));
+	}
+
+	// same as Each but the entities are split in chunks run on the registry thread pool
+	// the callback may only write the visited components, structural changes are buffered per chunk
+	template <typename TFunc> void ParallelEach(TFunc func) const;
+
+	// upper bound on the number of entities visited
+	int SizeHint() const {
+		return static_cast<int>(GetSmallestPoolEntities().size());
+	}
+};
+
+///////////////////////////////////////////////////
+// OwningGroup
+///////////////////////////////////////////////////
+// A group owns the pools of its components and keeps every entity that has all
+// of them packed in the same prefix range [0, size) of each pool, in identical order
+// iterating a group is a linear walk over parallel arrays
+// groups are kept up to date by the registry when components are added or removed
+///////////////////////////////////////////////////
+
+class IGroup {
+public:
+	virtual ~IGroup() = default;
+	// called after a component owned by the group was added to an entity
+	virtual void OnComponentAdded(Entity entity) = 0;
+	// called before a component owned by the group is removed from an entity
+	virtual void OnComponentRemoving(Entity entity) = 0;
+	// re-packs the owned pools after their content was replaced wholesale
+	virtual void Rebuild() = 0;
+};
+
+template <typename ...TComponents>
+class OwningGroup: public IGroup {
+private:
+	std::tuple<Pool<TComponents>*...> pools;
+	int size = 0;
+
+	using TLeader = std::tuple_element_t<0, std::tuple<TComponents...>>;
+
+	Pool<TLeader>* GetLeaderPool() const {
+		return std::get<0>(pools);
+	}
+
+	bool HasAllComponents(int entityId) const {
+		return std::apply([entityId](auto* ...pool) { return (pool->Has(entityId) && ...); }, pools);
+	}
+
+public:
+	OwningGroup(Pool<TComponents>* ...pools) : pools(pools...) {}
+
+	// packs entities that already have every component, called once the group owns its pools
+	void Initialize() {
+		const auto& entities = GetLeaderPool()->GetEntities();
+		for (size_t i = 0; i < entities.size(); i++) {
+			OnComponentAdded(entities[i]);
+		}
+	}
+
+	void Rebuild() override {
+		size = 0;
+		Initialize();
+	}
+
+	void OnComponentAdded(Entity entity) override {
+		const int entityId = entity.GetId();
+		if (!HasAllComponents(entityId) || GetLeaderPool()->GetIndex(entityId) < size) {
+			return;
+		}
+
+		// move the entity to the end of the packed range in every owned pool
+		std::apply([this, entityId](auto* ...pool) { (pool->Swap(pool->GetIndex(entityId), size), ...); }, pools);
+		size++;
+	}
+
+	void OnComponentRemoving(Entity entity) override {
+		const int entityId = entity.GetId();
+		if (!HasAllComponents(entityId) || GetLeaderPool()->GetIndex(entityId) >= size) {
+			return;
+		}
+
+		// move the entity just past the packed range so the pool's swap-and-pop leaves the range intact
+		size--;
+		std::apply([this, entityId](auto* ...pool) { (pool->Swap(pool->GetIndex(entityId), size), ...); }, pools);
+	}
+
+	int GetSize() const {
+		return size;
+	}
+
+	// callback signature: void(Entity, TComponents&...)
+	// components of the grouped types must not be added or removed inside the callback
+	template <typename TFunc>
+	void Each(TFunc func) const {
+		EachInRange(func, 0, size);
+	}
+
+	template <typename TFunc>
+	void EachInRange(TFunc& func, int begin, int end) const {
+		const auto& entities = GetLeaderPool()->GetEntities();
+
+		for (int i = begin; i < end; i++) {
+			std::apply([&func, &entities, i](auto* ...pool) { func(entities[i], (*pool)[i]...); }, pools);
+		}
+	}
+
+	// same as Each but the packed range is split in chunks run on the registry thread pool
+	template <typename TFunc> void ParallelEach(TFunc func) const;
+};
+
+#endif
+
+///////////////////////////////////////////////////
+// ComponentObservers
+///////////////////////////////////////////////////
+// lifecycle signals and dirty tracking for one component type
+// construct fires after a component is added, update after it is patched,
+// destroy before it is removed while its data is still readable
+///////////////////////////////////////////////////
+
+typedef std::function<void(Entity)> ComponentCallback;
+
+struct ComponentObservers {
+	std::vector<ComponentCallback> onConstruct;
+	std::vector<ComponentCallback> onUpdate;
+	std::vector<ComponentCallback> onDestroy;
+
+	// entities patched since the last registry update, each listed once
+	std::vector<Entity> changedEntities;
+	// the complete list of the frame before, which is what GetChanged returns
+	std::vector<Entity> previousChangedEntities;
+
+	// vector index = entity id
+	std::vector<bool> changed;
+
+	void Notify(const std::vector<ComponentCallback>& callbacks, Entity entity) const {
+		for (const auto& callback : callbacks) {
+			callback(entity);
+		}
+	}
+
+	void MarkChanged(Entity entity) {
+		const auto entityId = entity.GetId();
+		if (entityId >= static_cast<int>(changed.size())) {
+			changed.resize(entityId + 1, false);
+		}
+
+		if (!changed[entityId]) {
+			changed[entityId] = true;
+			changedEntities.push_back(entity);
+		}
+	}
+
+	// the list being filled becomes the previous frame's list, and a new one starts
+	void SwapChanged() {
+		for (auto entity : changedEntities) {
+			changed[entity.GetId()] = false;
+		}
+		previousChangedEntities.swap(changedEntities);
+		changedEntities.clear();
+	}
+
+	void ClearChanged() {
+		SwapChanged();
+		previousChangedEntities.clear();
+	}
+};
+
+///////////////////////////////////////////////////
+// Prefab
+///////////////////////////////////////////////////
+// a set of components with default values and groups, instantiated in bulk
+// ie: registry->Instantiate(bulletPrefab, 100, [](Entity entity, int index) {...});
+// prefabs are cheap to copy, component defaults are shared between copies
+///////////////////////////////////////////////////
+
+class IPrefabComponent {
+public:
+	virtual ~IPrefabComponent() = default;
+	virtual int GetComponentId() const = 0;
+	// adds a copy of the default value to each entity
+	virtual void Instantiate(Registry& registry, const Entity* entities, int count) const = 0;
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	// lets the storage lay out the prefab's archetype, then copies the default value into rows already allocated there
+	virtual void RegisterType(ArchetypeStorage& storage) const = 0;
+	virtual void Construct(ArchetypeStorage& storage, const Entity* entities, int count) const = 0;
+#endif
+};
+
+template <typename TComponent>
+class PrefabComponent : public IPrefabComponent {
+private:
+	TComponent value;
+
+public:
+	PrefabComponent(TComponent&& value) : value(std::move(value)) {};
+
+	int GetComponentId() const override {
+		return Component<TComponent>::GetId();
+	}
+
+	void Instantiate(Registry& registry, const Entity* entities, int count) const override;
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	void RegisterType(ArchetypeStorage& storage) const override {
+		storage.RegisterType<TComponent>();
+	}
+
+	void Construct(ArchetypeStorage& storage, const Entity* entities, int count) const override {
+		for (int i = 0; i < count; i++) {
+			storage.Construct(entities[i], value);
+		}
+	}
+#endif
+};
+
+// called once per instantiated entity after its components were added, index counts from 0
+typedef std::function<void(Entity entity, int index)> PrefabInitFunc;
+
+class Prefab {
+private:
+	std::vector<std::shared_ptr<const IPrefabComponent>> components;
+	Signature signature;
+	std::vector<int> groups;
+
+public:
+	// sets the default value of a component, replacing a previous one of the same type
+	template <typename TComponent, typename ...TArgs>
+	Prefab& Add(TArgs&& ...args) {
+		const int componentId = Component<TComponent>::GetId();
+		auto component = std::make_shared<const PrefabComponent<TComponent>>(TComponent(std::forward<TArgs>(args)...));
+
+		auto existing = std::find_if(components.begin(), components.end(), [componentId](const auto& other) { return other->GetComponentId() == componentId; });
+		if (existing != components.end()) {
+			*existing = std::move(component);
+		}
+		else {
+			components.push_back(std::move(component));
+		}
+		signature.set(componentId);
+		return *this;
+	}
+
+	Prefab& Group(int group) {
+		if (std::find(groups.begin(), groups.end(), group) == groups.end()) {
+			groups.push_back(group);
+		}
+		return *this;
+	}
+
+	Prefab& Group(const std::string& group);
+
+	// drops the groups of the prefab, ie: before giving a copy its own group
+	Prefab& ClearGroups() {
+		groups.clear();
+		return *this;
+	}
+
+	const std::vector<std::shared_ptr<const IPrefabComponent>>& GetComponents() const {
+		return components;
+	}
+
+	const Signature& GetSignature() const {
+		return signature;
+	}
+
+	const std::vector<int>& GetGroups() const {
+		return groups;
+	}
+};
+
+///////////////////////////////////////////////////
+// CommandBuffer
+///////////////////////////////////////////////////
+// records structural changes (create, kill, add and remove component) so
+// systems running off the main thread never mutate registry state directly
+// buffers are played back in creation order at the start of the next registry update
+///////////////////////////////////////////////////
+
+class ICommand {
+protected:
+	// swaps a placeholder handle for the entity created for it, false if it was not created (yet)
+	static bool Resolve(Registry& registry, Entity& entity);
+
+public:
+	virtual ~ICommand() = default;
+	virtual void Execute(Registry& registry) = 0;
+};
+
+class CreateEntityCommand : public ICommand {
+private:
+	Entity entity;
+
+public:
+	CreateEntityCommand(Entity entity) : entity(entity) {};
+	void Execute(Registry& registry) override;
+};
+
+class KillEntityCommand : public ICommand {
+private:
+	Entity entity;
+
+public:
+	KillEntityCommand(Entity entity) : entity(entity) {};
+	void Execute(Registry& registry) override;
+};
+
+template <typename TComponent>
+class AddComponentCommand : public ICommand {
+private:
+	Entity entity;
+	TComponent component;
+
+public:
+	AddComponentCommand(Entity entity, TComponent&& component) : entity(entity), component(std::move(component)) {};
+	void Execute(Registry& registry) override;
+};
+
+template <typename TComponent>
+class RemoveComponentCommand : public ICommand {
+private:
+	Entity entity;
+
+public:
+	RemoveComponentCommand(Entity entity) : entity(entity) {};
+	void Execute(Registry& registry) override;
+};
+
+class TagEntityCommand : public ICommand {
+private:
+	Entity entity;
+	int tag;
+
+public:
+	TagEntityCommand(Entity entity, int tag) : entity(entity), tag(tag) {};
+	void Execute(Registry& registry) override;
+};
+
+class GroupEntityCommand : public ICommand {
+private:
+	Entity entity;
+	int group;
+
+public:
+	GroupEntityCommand(Entity entity, int group) : entity(entity), group(group) {};
+	void Execute(Registry& registry) override;
+};
+
+class InstantiateCommand : public ICommand {
+private:
+	Prefab prefab;
+	std::vector<Entity> entities;
+	PrefabInitFunc initFunc;
+
+public:
+	InstantiateCommand(const Prefab& prefab, std::vector<Entity>&& entities, PrefabInitFunc&& initFunc) : prefab(prefab), entities(std::move(entities)), initFunc(std::move(initFunc)) {};
+	void Execute(Registry& registry) override;
 };
 
-template <typename T>
-class Pool: public IPool {
+class CommandBuffer {
 private:
-	std::vector<T> data;
-	int size;
+	Registry* registry;
+	std::vector<std::unique_ptr<ICommand>> commands;
 
-	std::unordered_map<int, int> entityIdToIndex;
-	std::unordered_map<int, int> indexToEntityId;
+	// components written in place while the buffer was active, as entity and component id
+	// the write itself is done already, only marking them changed is deferred
+	std::vector<std::pair<Entity, int>> patches;
+
+	// buffer receiving the structural changes made on the calling thread, nullptr to apply them directly
+	static thread_local CommandBuffer* active;
 
 public:
-	Pool(int capacity = 100) {
-		size = 0;
-		data.resize(capacity);
-	}
+	CommandBuffer(Registry* registry) : registry(registry) {};
 
-	~Pool() = default;
+	// move the commands of another buffer to the end of this one
+	void Append(CommandBuffer& other);
+
+	// the returned handle is a placeholder that later commands can refer to until playback
+	// the real id is assigned at playback, so ids follow buffer and command order and not thread timing
+	Entity CreateEntity();
+	void KillEntity(Entity entity);
+	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
+	template <typename TComponent> void RemoveComponent(Entity entity);
+	void TagEntity(Entity entity, int tag);
+	void GroupEntity(Entity entity, int group);
+	void Instantiate(const Prefab& prefab, std::vector<Entity>&& entities, PrefabInitFunc&& initFunc);
+	void MarkPatched(Entity entity, int componentId);
 
 	bool IsEmpty() const {
-		return size == 0;
+		return commands.empty() && patches.empty();
 	}
 
-	int GetSize() const {
-		return size;
+	// drop recorded commands without applying them
+	void Clear() {
+		commands.clear();
+		patches.clear();
 	}
 
-	void Resize(int n) {
-		data.resize(n);
-	}
+	// mark patched components changed, then apply recorded commands in the order they were recorded
+	void Playback();
 
-	void Clear() {
-		data.clear();
-		size = 0;
+	static CommandBuffer* GetActive() {
+		return active;
 	}
 
-	void Add(T object) {
-		data.push_back(object);
-	}
+	// routes Registry::CreateEntity, Instantiate, Entity::Kill, AddComponent, RemoveComponent, Tag and Group
+	// on the current thread into the buffer while in scope
+	class Scope {
+	private:
+		CommandBuffer* previous;
 
-	void Set(int entityId, T object) {
-		if (entityIdToIndex.find(entityId) != entityIdToIndex.end()) {
-			// if element exists already, replace it
-			int index = entityIdToIndex[entityId];
-			data[index] = object;
+	public:
+		Scope(CommandBuffer& buffer) : previous(active) {
+			active = &buffer;
 		}
-		else {
-			// keep track of entity id and its vector index
-			int index = size;
-			entityIdToIndex.emplace(entityId, index);
-			indexToEntityId.emplace(index, entityId);
-
-			//resize by doubling if necessary
-			if (index >= data.capacity()) {
-				data.resize(size * 2);
-			}
+		~Scope() {
+			active = previous;
+		}
+	};
+
+	// applies structural changes on the current thread directly while in scope, for exclusive
+	// systems that need a component they add right away
+	class DirectScope {
+	private:
+		CommandBuffer* previous;
 
-			data[index] = object;
-			size++;
+	public:
+		DirectScope() : previous(active) {
+			active = nullptr;
 		}
-	}
+		~DirectScope() {
+			active = previous;
+		}
+	};
+};
 
-	void Remove(int entityId) {
-		// copy last element to deleted position for contiguity
-		int indexOfRemoved = entityIdToIndex[entityId];
-		int indexOfLast = size - 1;
-		data[indexOfRemoved] = data[indexOfLast];
+///////////////////////////////////////////////////
+// ComponentSerializer
+///////////////////////////////////////////////////
+// writes a component pool to a snapshot block and reads it back
+// trivially copyable components are copied as one raw array, other
+// components go through the save and load functions given at registration
+///////////////////////////////////////////////////
 
-		// update index-entity maps
-		int entityOfLastElement = indexToEntityId[indexOfLast];
-		entityIdToIndex[entityOfLastElement] = indexOfRemoved;
-		indexToEntityId[indexOfRemoved] = entityOfLastElement;
+class IComponentSerializer {
+public:
+	virtual ~IComponentSerializer() = default;
+	// writes the block header, entity handles and component data of the pool
+	virtual void Save(int componentId, const IPool& pool, SnapshotWriter& writer) const = 0;
+	// fills the pool with the components of a block, reader covers the block data only
+	virtual bool Load(const SnapshotBlockHeader& header, const Entity* entities, SnapshotReader& reader, IPool& pool) const = 0;
+};
 
-		entityIdToIndex.erase(entityId);
-		indexToEntityId.erase(indexOfLast);
+template <typename TComponent>
+class ComponentSerializer : public IComponentSerializer {
+public:
+	typedef std::function<void(const TComponent&, SnapshotWriter&)> SaveFunc;
+	typedef std::function<TComponent(SnapshotReader&)> LoadFunc;
 
-		size--;
-	}
+private:
+	// empty for components copied as raw arrays
+	SaveFunc save;
+	LoadFunc load;
 
-	void RemoveEntityFromPool(int entityId) override {
-		if (entityIdToIndex.find(entityId) != entityIdToIndex.end()) {
-			Remove(entityId);
+public:
+	ComponentSerializer(SaveFunc save, LoadFunc load) : save(std::move(save)), load(std::move(load)) {};
+
+	void Save(int componentId, const IPool& pool, SnapshotWriter& writer) const override {
+		const auto& typedPool = static_cast<const Pool<TComponent>&>(pool);
+		const auto& entities = typedPool.GetEntities();
+		const auto& components = typedPool.GetData();
+
+		SnapshotBlockHeader header = {};
+		header.componentId = componentId;
+		header.componentSize = save ? 0 : sizeof(TComponent);
+		header.numComponents = static_cast<uint32_t>(components.size());
+
+		const size_t headerOffset = writer.GetSize();
+		writer.Write(header);
+		writer.WriteArray(entities.data(), entities.size());
+		writer.Align();
+
+		const size_t dataOffset = writer.GetSize();
+		if (save) {
+			for (const auto& component : components) {
+				save(component, writer);
+			}
+		}
+		else if constexpr (std::is_trivially_copyable_v<TComponent>) {
+			writer.WriteArray(components.data(), components.size());
 		}
-	}
 
-	T& Get(int entityId) {
-		int index = entityIdToIndex[entityId];
-		return static_cast<T&>(data[index]);
+		// the data size is known once the components are written
+		header.dataSize = writer.GetSize() - dataOffset;
+		writer.WriteAt(headerOffset, header);
 	}
 
-	bool operator [](unsigned int index) {
-		return data[index];
+	bool Load(const SnapshotBlockHeader& header, const Entity* entities, SnapshotReader& reader, IPool& pool) const override {
+		auto& typedPool = static_cast<Pool<TComponent>&>(pool);
+		const int numComponents = static_cast<int>(header.numComponents);
+
+		if (header.componentSize == 0 && load) {
+			std::vector<TComponent> components;
+			components.reserve(numComponents);
+			for (int i = 0; i < numComponents && !reader.HasFailed(); i++) {
+				components.push_back(load(reader));
+			}
+			if (reader.HasFailed()) {
+				return false;
+			}
+			typedPool.Assign(entities, numComponents, std::make_move_iterator(components.begin()));
+			return true;
+		}
+
+		if constexpr (std::is_trivially_copyable_v<TComponent>) {
+			if (header.componentSize == sizeof(TComponent)) {
+				const TComponent* components = reader.ReadArray<TComponent>(numComponents);
+				if (components) {
+					typedPool.Assign(entities, numComponents, components);
+				}
+				return components != nullptr;
+			}
+		}
+		return false;
 	}
 };
 
+///////////////////////////////////////////////////
+// SymbolTable
+///////////////////////////////////////////////////
+// interns names (tags, groups) to small integer ids once, so
+// membership checks compare integers instead of hashing strings
+///////////////////////////////////////////////////
+
+class SymbolTable {
+private:
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, int> ids;
+	std::vector<std::string> names;
+
+public:
+	// id of the name, assigned in order of first use
+	int Intern(const std::string& name);
+	// id of an already interned name or -1, never adds the name
+	int Find(const std::string& name) const;
+	std::string GetName(int id) const;
+	int GetSize() const;
+};
 
 ///////////////////////////////////////////////////
 // Registry
@@ -211,38 +1277,164 @@ public:
 class Registry {
 private:
 	int numEntities = 0;
-	std::set<Entity> entitiesToBeAdded;
 	std::set<Entity> entitiesToBeKilled;
 
+	// entity ids handed out by ReserveEntity since the last sync
+	// the first ones are taken from the front of freeIds, the rest follow numEntities
+	std::atomic<int> numReservedEntities = 0;
+
+	// placeholder handles given out by command buffers, numbered in whatever order threads ask
+	// playback binds each one to the entity created for it, bindings last until the end of the update
+	std::atomic<uint32_t> nextPlaceholder = 0;
+	std::unordered_map<uint32_t, Entity> entityOfPlaceholder;
+
+	// command buffers in playback order
+	std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+
+	// pool running parallel loops, nullptr to run them on the calling thread
+	ThreadPool* threadPool = nullptr;
+
+	// entities created or whose signature changed since the last update
+	// their system membership is re-evaluated in the next update
+	std::vector<Entity> entitiesToBeRefreshed;
+	std::vector<bool> entityRefreshPending;
+
+	// entities instantiated from a prefab since the last update, sharing the prefab signature
+	// matching systems are looked up once per batch instead of once per entity
+	struct PrefabBatch {
+		Signature signature;
+		std::vector<Entity> entities;
+	};
+	std::vector<PrefabBatch> prefabBatches;
+
+	// prefabs defined by name (ie: in level scripts)
+	std::unordered_map<std::string, Prefab> prefabs;
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	// entities grouped by signature into chunked SoA archetypes
+	ArchetypeStorage archetypeStorage;
+#else
 	// Vector of component pools, each containing all of the data for a specific component type
 	// vector index = component type id
 	// pool index = entity id
 	std::vector<std::shared_ptr<IPool>> componentPools;
+#endif
+
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	// owning groups, keyed by their component list
+	std::unordered_map<std::type_index, std::unique_ptr<IGroup>> groups;
+
+	// group owning each component pool, nullptr if the pool is free
+	// vector index = component type id
+	std::vector<IGroup*> componentGroupOwners;
+
+	IGroup* GetGroupOwner(int componentId) const {
+		return componentId < static_cast<int>(componentGroupOwners.size()) ? componentGroupOwners[componentId] : nullptr;
+	}
+#endif
 
 	// signatures denote which components are enabled for each entity
 	// vector index = entity id
 	std::vector<Signature> entityComponentSignatures;
 
+	// signature each entity had when its system membership was last evaluated
+	// vector index = entity id
+	std::vector<Signature> entitySystemSignatures;
+
+	// components removed since the last update whose data is still held in storage
+	// vector index = entity id
+	std::vector<Signature> entityComponentsToBeRemoved;
+
+	// current generation of each entity id, bumped when the id is freed
+	// vector index = entity id
+	std::vector<uint32_t> entityGenerations;
+
+	// lifecycle signals and changed lists, created on first use
+	// vector index = component type id
+	std::vector<std::unique_ptr<ComponentObservers>> componentObservers;
+
+	ComponentObservers* FindObservers(int componentId) const {
+		return componentId < static_cast<int>(componentObservers.size()) ? componentObservers[componentId].get() : nullptr;
+	}
+	ComponentObservers& GetObservers(int componentId);
+
+	void MarkEntityForRefresh(Entity entity);
+	void RemoveComponentData(Entity entity, int componentId);
+
+	// adds prefab batches and refreshed entities to the systems they now match
+	void RefreshPendingEntities();
+
+	// marks a component changed and notifies its update observers
+	void OnComponentPatched(Entity entity, int componentId);
+
+	// adds a copy of the component to each of the entities in one pass
+	template <typename TComponent> void AddComponents(const Entity* entities, int count, const TComponent& component);
+	// signature and observer side of adding a component whose storage is already filled
+	void OnComponentsAdded(int componentId, const Entity* entities, int count);
+	void InstantiateReserved(const Prefab& prefab, const std::vector<Entity>& entities, const PrefabInitFunc& initFunc);
+
+	// ids are reserved and claimed on the main thread, so they only depend on the order of creation
+	Entity ReserveEntity();
+	void ReserveEntities(int count, std::vector<Entity>& entities);
+	// claims reserved ids so they are no longer free
+	void SyncReservedEntities();
+
+	// lock free, safe to call from any thread
+	Entity CreatePlaceholder();
+	void CreatePlaceholders(int count, std::vector<Entity>& entities);
+	void BindPlaceholder(Entity placeholder, Entity entity);
+
+	friend class CommandBuffer;
+	friend class ICommand;
+	friend class CreateEntityCommand;
+	friend class InstantiateCommand;
+	template <typename TComponent> friend class PrefabComponent;
+
 	// map of active systems
 	// index = system type id
 	std::unordered_map<std::type_index, std::shared_ptr<System>> systems;
 
-	// Entity tags (one per entity)
-	std::unordered_map<std::string, Entity> entityPerTag;
-	std::unordered_map<int, std::string> tagPerEntity;
+	// interned tag and group names, shared by every registry so ids can be cached by systems
+	static SymbolTable tagSymbols;
+	static SymbolTable groupSymbols;
+
+	// Entity tags (one entity per tag, one tag per entity)
+	// tagPerEntity index = entity id, -1 if untagged
+	std::unordered_map<int, Entity> entityPerTag;
+	std::vector<int> tagPerEntity;
 
-	// Entity groups
-	std::unordered_map<std::string, std::set<Entity>> entitiesPerGroup;
-	std::unordered_map<int, std::string> groupPerEntity;
+	// Entity groups (any number of groups per entity)
+	// bit i is set if the entity belongs to group id i
+	// vector index = entity id
+	std::vector<uint64_t> entityGroupMasks;
+
+	// members of each group with their position in the list, for constant time removal
+	// vector index = group id
+	struct GroupMembers {
+		std::vector<Entity> entities;
+		std::vector<int> positions;
+	};
+	std::vector<GroupMembers> entitiesPerGroup;
 
 	// list of available entity ids previously removed
 	std::deque<int> freeIds;
 
+	// serializers of the components written to snapshots, nullptr if the component is not saved
+	// vector index = component type id
+	std::vector<std::unique_ptr<IComponentSerializer>> componentSerializers;
+
+	// drops every entity, component and pending change, keeping systems, groups and observers
+	void ClearEntities();
+
 public:
 	Registry() {
+		Entity::registry = this;
 		Logger::Log("Registry constructor called.");
 	}
 	~Registry() {
+		if (Entity::registry == this) {
+			Entity::registry = nullptr;
+		}
 		Logger::Log("Registry destructor called.");
 	}
 
@@ -251,6 +1443,27 @@ public:
 	// entity management
 	Entity CreateEntity();
 	void KillEntity(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	// create count entities with the components and groups of a prefab
+	// components are written in bulk and the entities join systems together in the next update
+	void Instantiate(const Prefab& prefab, int count, PrefabInitFunc initFunc = nullptr);
+	Entity Instantiate(const Prefab& prefab);
+
+	// named prefabs, FindPrefab returns nullptr if no prefab has the name
+	void SetPrefab(const std::string& name, const Prefab& prefab);
+	const Prefab* FindPrefab(const std::string& name) const;
+
+	// create a buffer for deferred structural changes, one per worker thread
+	// buffers are played back in creation order, owned by the registry
+	CommandBuffer& CreateCommandBuffer();
+
+	void SetThreadPool(ThreadPool* threadPool);
+
+	// split [0, size) into chunks whose boundaries are multiples of alignment and run
+	// func(begin, end) for each chunk on the thread pool, returns once every chunk finished
+	// structural changes are collected per chunk and applied in chunk order
+	template <typename TFunc> void ParallelFor(int size, int alignment, TFunc func);
 	
 	// component management
 	template <typename TComponent, typename ...TArgs> void AddComponent(Entity entity, TArgs&& ...args);
@@ -258,26 +1471,101 @@ public:
 	template <typename TComponent> bool HasComponent(Entity entity) const;
 	template <typename TComponent> TComponent& GetComponent(Entity entity) const;
 
+	// modify a component in place, marking it changed and notifying update observers
+	// inside a command buffer scope the write happens right away and the marking at playback
+	// ie: registry->Patch<TransformComponent>(entity, [](TransformComponent& transform) { ... });
+	template <typename TComponent, typename TFunc> void Patch(Entity entity, TFunc func);
+	// same tracking for a component already written through a reference, ie: inside View().Each
+	template <typename TComponent> void MarkPatched(Entity entity);
+
+	// entities whose component was patched during the previous frame, between the last two updates
+	// the list is complete even for patches made after a system read it, and may contain killed entities
+	template <typename TComponent> const std::vector<Entity>& GetChanged();
+
+	// component lifecycle observers
+	template <typename TComponent> void OnConstruct(ComponentCallback callback);
+	template <typename TComponent> void OnUpdate(ComponentCallback callback);
+	template <typename TComponent> void OnDestroy(ComponentCallback callback);
+
+	// pool memory, must be called between updates since growing or shrinking a pool moves its components
+	// the archetype backend allocates fixed size chunks and frees empty ones, so these do nothing there
+	// ie: registry->Reserve<TransformComponent>(5000);
+	template <typename TComponent> void Reserve(int capacity);
+	template <typename TComponent> void ShrinkToFit();
+
+	// shrinks every pool using less than a quarter of its capacity, down to what was reserved for it
+	void Compact();
+
+	// reorders a pool so iterating it visits components in compare order, must be called between updates
+	// pools owned by a group keep the group order, and the archetype backend does not support sorting
+	// ie: registry->Sort<SpriteComponent>([](const SpriteComponent& a, const SpriteComponent& b) { return a.zIndex < b.zIndex; });
+	template <typename TComponent, typename TCompare> void Sort(TCompare compare, SortAlgorithm algorithm = SORT_DEFAULT);
+	std::vector<PoolStats> GetPoolStats() const;
+
+	// snapshots store entity handles, tags, groups and the pools of registered components in a binary file
+	// trivially copyable components are written as one raw block, others through the given functions
+	// components without a serializer are dropped from saved entities
+	// ie: registry->RegisterSnapshotComponent<TransformComponent>();
+	template <typename TComponent> void RegisterSnapshotComponent();
+	template <typename TComponent> void RegisterSnapshotComponent(typename ComponentSerializer<TComponent>::SaveFunc save, typename ComponentSerializer<TComponent>::LoadFunc load);
+
+	// must be called between updates, loading replaces every entity and fills systems right away
+	// handles saved in the snapshot stay valid after loading it
+	bool SaveSnapshot(const std::string& path);
+	bool LoadSnapshot(const std::string& path);
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	template <typename TComponent> Pool<TComponent>* GetPool();
+	template <typename TComponent> Pool<TComponent>* FindPool() const;
+#endif
+
+	// iterate entities having all of the given components
+	template <typename ...TComponents> ComponentView<TComponents...> View();
+
+	// iterate entities having all of the given components, packing their pools so the walk is linear
+	// a component pool can be owned by a single group
+	// ie: registry->Group<TransformComponent, RigidBodyComponent>().Each(...)
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	template <typename ...TComponents> ComponentView<TComponents...> Group();
+#else
+	template <typename ...TComponents> OwningGroup<TComponents...>& Group();
+#endif
+
 	//system management
 	template <typename TSystem, typename ...TArgs> void AddSystem(TArgs&& ...args);
 	template <typename TSystem> void RemoveSystem();
 	template <typename TSystem> bool HasSystem() const;
 	template <typename TSystem> TSystem& GetSystem() const;
 
-	void AddEntityToSystems(Entity entity);
+	void RefreshEntityInSystems(Entity entity);
 	void RemoveEntityFromSystems(Entity entity);
 
+	// tag and group name interning
+	// ie: const int projectilesGroup = Registry::InternGroup("projectiles");
+	static int InternTag(const std::string& tag);
+	static int InternGroup(const std::string& group);
+	// queries look names up without interning, unknown names give -1
+	static int FindTag(const std::string& tag);
+	static int FindGroup(const std::string& group);
+	static std::string GetGroupName(int group);
+
 	// tag management
 	void TagEntity(Entity entity, const std::string& tag);
+	void TagEntity(Entity entity, int tag);
 	bool EntityHasTag(Entity entity, const std::string& tag) const;
+	bool EntityHasTag(Entity entity, int tag) const;
 	Entity GetEntityByTag(const std::string& tag) const;
+	Entity GetEntityByTag(int tag) const;
 	void RemoveEntityTag(Entity entity);
 
 	//group management
 	void GroupEntity(Entity entity, const std::string& group);
+	void GroupEntity(Entity entity, int group);
 	bool EntityBelongsToGroup(Entity entity, const std::string& group) const;
-	std::vector<Entity> GetEntitiesByGroup(const std::string& group) const;
-	void RemoveEntityGroup(Entity entity);
+	bool EntityBelongsToGroup(Entity entity, int group) const;
+	const std::vector<Entity>& GetEntitiesByGroup(const std::string& group) const;
+	const std::vector<Entity>& GetEntitiesByGroup(int group) const;
+	void RemoveEntityFromGroup(Entity entity, int group);
+	void RemoveEntityGroups(Entity entity);
 	
 };
 
@@ -287,6 +1575,22 @@ void System::RequireComponent() {
 	componentSignature.set(componentId);
 }
 
+template <typename TComponent>
+void System::ExcludeComponent() {
+	const auto componentId = Component<TComponent>::GetId();
+	excludeSignature.set(componentId);
+}
+
+template <typename TComponent>
+void System::Reads() {
+	readSignature.set(Component<TComponent>::GetId());
+}
+
+template <typename TComponent>
+void System::Writes() {
+	writeSignature.set(Component<TComponent>::GetId());
+}
+
 template <typename TSystem, typename ...TArgs>
 void Registry::AddSystem(TArgs&& ...args) {
 	std::shared_ptr<TSystem> newSystem = std::make_shared<TSystem>(std::forward<TArgs>(args)...);
@@ -310,13 +1614,13 @@ TSystem& Registry::GetSystem() const {
 	return *(std::static_pointer_cast<TSystem> (system->second));
 }
 
-template <typename TComponent, typename ...TArgs>
-void Registry::AddComponent(Entity entity, TArgs&& ...args) {
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+template <typename TComponent>
+Pool<TComponent>* Registry::GetPool() {
 	const auto componentId = Component<TComponent>::GetId();
-	const auto entityId = entity.GetId();
 
 	// resize pools to accommodate new component pool
-	if (componentId >= componentPools.size()) {
+	if (static_cast<size_t>(componentId) >= componentPools.size()) {
 		componentPools.resize(componentId + 1, nullptr);
 	}
 
@@ -326,31 +1630,163 @@ void Registry::AddComponent(Entity entity, TArgs&& ...args) {
 		componentPools[componentId] = newComponentPool;
 	}
 
-	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+	return static_cast<Pool<TComponent>*>(componentPools[componentId].get());
+}
+
+template <typename TComponent>
+Pool<TComponent>* Registry::FindPool() const {
+	const auto componentId = Component<TComponent>::GetId();
+	if (static_cast<size_t>(componentId) < componentPools.size() && componentPools[componentId]) {
+		return static_cast<Pool<TComponent>*>(componentPools[componentId].get());
+	}
+
+	// missing pools are not created here so views can be built from worker threads
+	static Pool<TComponent> emptyPool;
+	return &emptyPool;
+}
+#endif
+
+template <typename ...TComponents>
+ComponentView<TComponents...> Registry::View() {
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	return ComponentView<TComponents...>(&archetypeStorage);
+#else
+	return ComponentView<TComponents...>(FindPool<TComponents>()...);
+#endif
+}
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+template <typename ...TComponents>
+ComponentView<TComponents...> Registry::Group() {
+	// entities sharing a signature are already packed together in their archetype chunks
+	return View<TComponents...>();
+}
+#else
+template <typename ...TComponents>
+OwningGroup<TComponents...>& Registry::Group() {
+	const auto groupType = std::type_index(typeid(OwningGroup<TComponents...>));
+	auto group = groups.find(groupType);
+	if (group != groups.end()) {
+		return static_cast<OwningGroup<TComponents...>&>(*group->second);
+	}
+
+	const int componentIds[] = { Component<TComponents>::GetId()... };
+	bool isOwnedElsewhere = false;
+	for (int componentId : componentIds) {
+		isOwnedElsewhere = isOwnedElsewhere || GetGroupOwner(componentId);
+	}
+
+	auto newGroup = std::make_unique<OwningGroup<TComponents...>>(GetPool<TComponents>()...);
+	OwningGroup<TComponents...>& result = *newGroup;
+
+	if (isOwnedElsewhere) {
+		// leave the conflicting group empty instead of corrupting the other group's ordering
+		Logger::Err("Group requested for a component pool that is already owned by another group.");
+	}
+	else {
+		for (int componentId : componentIds) {
+			if (componentId >= static_cast<int>(componentGroupOwners.size())) {
+				componentGroupOwners.resize(componentId + 1, nullptr);
+			}
+			componentGroupOwners[componentId] = newGroup.get();
+		}
+		result.Initialize();
+	}
+
+	groups.emplace(groupType, std::move(newGroup));
+	return result;
+}
+#endif
+
+template <typename TComponent, typename ...TArgs>
+void Registry::AddComponent(Entity entity, TArgs&& ...args) {
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->AddComponent<TComponent>(entity, std::forward<TArgs>(args)...);
+		return;
+	}
+
+	const auto componentId = Component<TComponent>::GetId();
+	const auto entityId = entity.GetId();
 
 	// create a new component and forward given arguments
 	TComponent newComponent(std::forward<TArgs>(args)...);
 
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	// move entity into the archetype of its new signature
+	archetypeStorage.Set(entity, std::move(newComponent));
+#else
 	// add to component pool list for entity
-	componentPool->Set(entityId, newComponent);
+	GetPool<TComponent>()->Set(entity, std::move(newComponent));
+
+	// pack entity into the group owning this pool
+	if (IGroup* group = GetGroupOwner(componentId)) {
+		group->OnComponentAdded(entity);
+	}
+#endif
 
-	// set component in corresponding signature
+	// set component in corresponding signature, cancelling a removal requested this frame
 	entityComponentSignatures[entityId].set(componentId);
+	entityComponentsToBeRemoved[entityId].set(componentId, false);
+	MarkEntityForRefresh(entity);
+
+	if (ComponentObservers* observers = FindObservers(componentId)) {
+		observers->Notify(observers->onConstruct, entity);
+	}
+
+	WOO_LOG_DEBUG("Component id = " + std::to_string(componentId) + " was added to entity id = " + std::to_string(entityId));
+}
+
+template <typename TComponent>
+void Registry::AddComponents(const Entity* entities, int count, const TComponent& component) {
+	const auto componentId = Component<TComponent>::GetId();
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	for (int i = 0; i < count; i++) {
+		archetypeStorage.Set(entities[i], TComponent(component));
+	}
+#else
+	GetPool<TComponent>()->SetMany(entities, count, component);
+
+	if (IGroup* group = GetGroupOwner(componentId)) {
+		for (int i = 0; i < count; i++) {
+			group->OnComponentAdded(entities[i]);
+		}
+	}
+#endif
+
+	OnComponentsAdded(componentId, entities, count);
+}
 
-	Logger::Log("Component id = " + std::to_string(componentId) + " was added to entity id = " + std::to_string(entityId));
+template <typename TComponent>
+void PrefabComponent<TComponent>::Instantiate(Registry& registry, const Entity* entities, int count) const {
+	registry.AddComponents<TComponent>(entities, count, value);
 }
 
 template <typename TComponent>
 void Registry::RemoveComponent(Entity entity) {
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->RemoveComponent<TComponent>(entity);
+		return;
+	}
+
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 
-	entityComponentSignatures[entityId].set(componentId, false);
+	if (!entityComponentSignatures[entityId].test(componentId)) {
+		return;
+	}
 
-	std::shared_ptr<Pool<TComponent>> componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
-	componentPool->remove(entityId);
+	if (ComponentObservers* observers = FindObservers(componentId)) {
+		observers->Notify(observers->onDestroy, entity);
+	}
+
+	// the component stops matching immediately, its data is released in the next update
+	// so systems iterating this frame never see it disappear from storage
+	entityComponentSignatures[entityId].set(componentId, false);
+	entityComponentsToBeRemoved[entityId].set(componentId);
+	MarkEntityForRefresh(entity);
 
-	Logger::Log("Component id = " + std::to_string(componentId) + " was removed from entity id = " + std::to_string(entityId));
+	WOO_LOG_DEBUG("Component id = " + std::to_string(componentId) + " was removed from entity id = " + std::to_string(entityId));
 }
 
 template <typename TComponent>
@@ -358,15 +1794,229 @@ bool Registry::HasComponent(Entity entity) const {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
 
-	return entityComponentSignatures[entityId].test(componentId);
+	return IsAlive(entity) && entityComponentSignatures[entityId].test(componentId);
 }
 
 template <typename TComponent>
 TComponent& Registry::GetComponent(Entity entity) const {
 	const auto componentId = Component<TComponent>::GetId();
 	const auto entityId = entity.GetId();
-	auto componentPool = std::static_pointer_cast<Pool<TComponent>>(componentPools[componentId]);
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	return archetypeStorage.Get<TComponent>(entity);
+#else
+	auto componentPool = static_cast<Pool<TComponent>*>(componentPools[componentId].get());
 	return componentPool->Get(entityId);
+#endif
+}
+
+template <typename TComponent, typename TFunc>
+void Registry::Patch(Entity entity, TFunc func) {
+	func(GetComponent<TComponent>(entity));
+	MarkPatched<TComponent>(entity);
+}
+
+template <typename TComponent>
+void Registry::MarkPatched(Entity entity) {
+	// changed lists and observers are not thread safe, worker threads leave the marking to playback
+	if (CommandBuffer* buffer = CommandBuffer::GetActive()) {
+		buffer->MarkPatched(entity, Component<TComponent>::GetId());
+		return;
+	}
+	OnComponentPatched(entity, Component<TComponent>::GetId());
+}
+
+template <typename TComponent>
+const std::vector<Entity>& Registry::GetChanged() {
+	return GetObservers(Component<TComponent>::GetId()).previousChangedEntities;
+}
+
+template <typename TComponent>
+void Registry::OnConstruct(ComponentCallback callback) {
+	GetObservers(Component<TComponent>::GetId()).onConstruct.push_back(std::move(callback));
+}
+
+template <typename TComponent>
+void Registry::OnUpdate(ComponentCallback callback) {
+	GetObservers(Component<TComponent>::GetId()).onUpdate.push_back(std::move(callback));
+}
+
+template <typename TComponent>
+void Registry::OnDestroy(ComponentCallback callback) {
+	GetObservers(Component<TComponent>::GetId()).onDestroy.push_back(std::move(callback));
+}
+
+template <typename TComponent>
+void Registry::Reserve(int capacity) {
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	GetPool<TComponent>()->Reserve(capacity);
+#endif
+}
+
+template <typename TComponent>
+void Registry::ShrinkToFit() {
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	GetPool<TComponent>()->ShrinkToFit();
+#endif
+}
+
+template <typename TComponent, typename TCompare>
+void Registry::Sort(TCompare compare, SortAlgorithm algorithm) {
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+	Logger::Err("Sorting components is only supported by the pool backend.");
+#else
+	if (GetGroupOwner(Component<TComponent>::GetId())) {
+		Logger::Err("Cannot sort a pool owned by a group.");
+		return;
+	}
+	GetPool<TComponent>()->Sort(compare, algorithm);
+#endif
+}
+
+template <typename TComponent>
+void Registry::RegisterSnapshotComponent() {
+	static_assert(std::is_trivially_copyable_v<TComponent>, "Components that are not trivially copyable need save and load functions.");
+	RegisterSnapshotComponent<TComponent>(nullptr, nullptr);
+}
+
+template <typename TComponent>
+void Registry::RegisterSnapshotComponent(typename ComponentSerializer<TComponent>::SaveFunc save, typename ComponentSerializer<TComponent>::LoadFunc load) {
+	static_assert(Component<TComponent>::registeredId != -1, "Snapshot components must be listed in ComponentTypes.h so their id is the same in every run.");
+	const auto componentId = Component<TComponent>::GetId();
+
+	if (componentId >= static_cast<int>(componentSerializers.size())) {
+		componentSerializers.resize(componentId + 1);
+	}
+	componentSerializers[componentId] = std::make_unique<ComponentSerializer<TComponent>>(std::move(save), std::move(load));
+
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+	// loading fills existing pools
+	GetPool<TComponent>();
+#endif
+}
+
+template <typename TFunc>
+void Registry::ParallelFor(int size, int alignment, TFunc func) {
+	if (size <= 0) {
+		return;
+	}
+
+	if (!threadPool) {
+		func(0, size);
+		return;
+	}
+
+	// a few chunks per thread so threads finishing early can steal the remainder
+	const int numThreads = threadPool->GetNumThreads() + 1;
+	int chunkSize = (size + numThreads * 4 - 1) / (numThreads * 4);
+	chunkSize = (chunkSize + alignment - 1) / alignment * alignment;
+	const int numChunks = (size + chunkSize - 1) / chunkSize;
+
+	if (numChunks == 1) {
+		func(0, size);
+		return;
+	}
+
+	std::vector<std::unique_ptr<CommandBuffer>> chunkBuffers;
+	for (int chunk = 0; chunk < numChunks; chunk++) {
+		chunkBuffers.push_back(std::make_unique<CommandBuffer>(this));
+	}
+
+	std::atomic<int> numUnfinishedChunks = numChunks;
+	for (int chunk = 0; chunk < numChunks; chunk++) {
+		threadPool->Submit([&func, &chunkBuffers, &numUnfinishedChunks, chunk, chunkSize, size]() {
+			CommandBuffer::Scope scope(*chunkBuffers[chunk]);
+			func(chunk * chunkSize, std::min(size, (chunk + 1) * chunkSize));
+			numUnfinishedChunks--;
+		});
+	}
+
+	// help with the chunks instead of blocking
+	while (numUnfinishedChunks > 0) {
+		if (!threadPool->RunPendingTask()) {
+			std::this_thread::yield();
+		}
+	}
+
+	// merge in chunk order so the result matches a serial loop
+	CommandBuffer* callerBuffer = CommandBuffer::GetActive();
+	for (auto& buffer : chunkBuffers) {
+		if (callerBuffer) {
+			callerBuffer->Append(*buffer);
+		}
+		else {
+			buffer->Playback();
+		}
+	}
+}
+
+#ifdef WOO_ECS_ARCHETYPE_STORAGE
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::ParallelEach(TFunc func) const {
+	// chunks are already cache line aligned, each parallel task takes whole chunks
+	std::vector<std::pair<const Archetype*, int>> chunks;
+	for (const Archetype* archetype : storage->GetArchetypes()) {
+		if (archetype->GetSignature().Contains(signature)) {
+			for (int chunkIndex = 0; chunkIndex < archetype->GetNumChunks(); chunkIndex++) {
+				chunks.emplace_back(archetype, chunkIndex);
+			}
+		}
+	}
+
+	Entity::registry->ParallelFor(static_cast<int>(chunks.size()), 1, [&func, &chunks](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const Archetype* archetype = chunks[i].first;
+			Chunk& chunk = archetype->GetChunk(chunks[i].second);
+			const Entity* entities = archetype->GetEntities(chunk);
+			auto columns = std::make_tuple(archetype->template GetColumn<TComponents>(chunk)...);
+
+			for (int row = 0; row < chunk.count; row++) {
+				std::apply([&func, entities, row](auto* ...column) { func(entities[row], column[row]...); }, columns);
+			}
+		}
+	});
+}
+#else
+template <typename ...TComponents>
+template <typename TFunc>
+void ComponentView<TComponents...>::ParallelEach(TFunc func) const {
+	const auto& entities = GetSmallestPoolEntities();
+	Entity::registry->ParallelFor(static_cast<int>(entities.size()), PARALLEL_CHUNK_ALIGNMENT, [this, &func, &entities](int begin, int end) {
+		EachInRange(func, entities, begin, end);
+	});
+}
+
+template <typename ...TComponents>
+template <typename TFunc>
+void OwningGroup<TComponents...>::ParallelEach(TFunc func) const {
+	Entity::registry->ParallelFor(size, PARALLEL_CHUNK_ALIGNMENT, [this, &func](int begin, int end) {
+		EachInRange(func, begin, end);
+	});
+}
+#endif
+
+template <typename TComponent>
+void AddComponentCommand<TComponent>::Execute(Registry& registry) {
+	if (Resolve(registry, entity)) {
+		registry.AddComponent<TComponent>(entity, std::move(component));
+	}
+}
+
+template <typename TComponent>
+void RemoveComponentCommand<TComponent>::Execute(Registry& registry) {
+	if (Resolve(registry, entity)) {
+		registry.RemoveComponent<TComponent>(entity);
+	}
+}
+
+template <typename TComponent, typename ...TArgs>
+void CommandBuffer::AddComponent(Entity entity, TArgs&& ...args) {
+	commands.push_back(std::make_unique<AddComponentCommand<TComponent>>(entity, TComponent(std::forward<TArgs>(args)...)));
+}
+
+template <typename TComponent>
+void CommandBuffer::RemoveComponent(Entity entity) {
+	commands.push_back(std::make_unique<RemoveComponentCommand<TComponent>>(entity));
 }
 
 
@@ -390,4 +2040,9 @@ bool Entity::HasComponent() const {
 template <typename TComponent>
 TComponent& Entity::GetComponent() const {
 	return registry->GetComponent<TComponent>(*this);
+}
+
+template <typename TComponent, typename TFunc>
+void Entity::Patch(TFunc func) {
+	registry->Patch<TComponent>(*this, func);
 }
\ No newline at end of file
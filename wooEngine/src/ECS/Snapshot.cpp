@@ -0,0 +1,148 @@
+#include "Snapshot.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void SnapshotWriter::WriteBytes(const void* bytes, size_t count) {
+	const char* begin = static_cast<const char*>(bytes);
+	buffer.insert(buffer.end(), begin, begin + count);
+}
+
+void SnapshotWriter::WriteString(const std::string& value) {
+	Write(static_cast<uint32_t>(value.size()));
+	WriteBytes(value.data(), value.size());
+}
+
+void SnapshotWriter::Align() {
+	const size_t padding = (SNAPSHOT_ALIGNMENT - buffer.size() % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+	buffer.insert(buffer.end(), padding, 0);
+}
+
+bool SnapshotWriter::SaveToFile(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(buffer.data(), buffer.size());
+	return file.good();
+}
+
+const char* SnapshotReader::ReadBytes(size_t count) {
+	if (failed || count > size - offset) {
+		failed = true;
+		return nullptr;
+	}
+	const char* bytes = data + offset;
+	offset += count;
+	return bytes;
+}
+
+bool SnapshotReader::ReadString(std::string& value) {
+	uint32_t length = 0;
+	if (!Read(length)) {
+		return false;
+	}
+	const char* bytes = ReadBytes(length);
+	if (bytes) {
+		value.assign(bytes, length);
+	}
+	return bytes != nullptr;
+}
+
+void SnapshotReader::Align() {
+	const size_t padding = (SNAPSHOT_ALIGNMENT - offset % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+	ReadBytes(padding);
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		Close();
+		return false;
+	}
+
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data) {
+		Close();
+		return false;
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+	data = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	size = 0;
+}
+#else
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor == -1) {
+		return false;
+	}
+
+	struct stat fileStatus;
+	if (fstat(descriptor, &fileStatus) != 0 || fileStatus.st_size == 0) {
+		Close();
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (mapped == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	data = static_cast<const char*>(mapped);
+	size = static_cast<size_t>(fileStatus.st_size);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		munmap(const_cast<char*>(data), size);
+	}
+	if (descriptor != -1) {
+		close(descriptor);
+	}
+	data = nullptr;
+	descriptor = -1;
+	size = 0;
+}
+#endif
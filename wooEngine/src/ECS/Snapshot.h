@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+///////////////////////////////////////////////////
+// Snapshot
+///////////////////////////////////////////////////
+// binary layout of a registry snapshot:
+// header, entity tables (generations, signatures, free ids, tags, groups),
+// then one block per saved component pool (header, entity handles, component data)
+// arrays start at SNAPSHOT_ALIGNMENT so a memory mapped file can be copied straight into pools
+// the layout is native (endianness, struct padding), snapshots are not portable between builds
+///////////////////////////////////////////////////
+
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_ALIGNMENT = 16;
+
+struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t signatureSize;
+	uint32_t numEntities;
+	uint32_t numFreeIds;
+	uint32_t numTagNames;
+	uint32_t numGroupNames;
+	uint32_t numComponentBlocks;
+};
+
+struct SnapshotBlockHeader {
+	int32_t componentId;
+	// sizeof the component for raw blocks, 0 for blocks written by a custom serializer
+	uint32_t componentSize;
+	uint32_t numComponents;
+	uint32_t padding;
+	// bytes of component data following the entity handles
+	uint64_t dataSize;
+};
+
+class SnapshotWriter {
+private:
+	std::vector<char> buffer;
+
+public:
+	void WriteBytes(const void* bytes, size_t count);
+	void WriteString(const std::string& value);
+
+	// pad with zeros up to the next SNAPSHOT_ALIGNMENT boundary
+	void Align();
+
+	template <typename T>
+	void Write(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written directly.");
+		WriteBytes(&value, sizeof(T));
+	}
+
+	// overwrite a value written earlier, used to fill in sizes once known
+	template <typename T>
+	void WriteAt(size_t offset, const T& value) {
+		std::memcpy(buffer.data() + offset, &value, sizeof(T));
+	}
+
+	// aligned so the array can be used in place once mapped
+	template <typename T>
+	void WriteArray(const T* values, size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be written directly.");
+		Align();
+		WriteBytes(values, count * sizeof(T));
+	}
+
+	size_t GetSize() const {
+		return buffer.size();
+	}
+
+	bool SaveToFile(const std::string& path) const;
+};
+
+class SnapshotReader {
+private:
+	const char* data;
+	size_t size;
+	size_t offset = 0;
+	bool failed = false;
+
+public:
+	SnapshotReader(const char* data, size_t size) : data(data), size(size) {};
+
+	// pointer to the next count bytes, nullptr (and failed) when reading past the end
+	const char* ReadBytes(size_t count);
+	bool ReadString(std::string& value);
+	void Align();
+
+	template <typename T>
+	bool Read(T& value) {
+		const char* bytes = ReadBytes(sizeof(T));
+		if (bytes) {
+			std::memcpy(&value, bytes, sizeof(T));
+		}
+		return bytes != nullptr;
+	}
+
+	// array written by SnapshotWriter::WriteArray, points into the mapped file
+	template <typename T>
+	const T* ReadArray(size_t count) {
+		Align();
+		return reinterpret_cast<const T*>(ReadBytes(count * sizeof(T)));
+	}
+
+	size_t GetOffset() const {
+		return offset;
+	}
+
+	bool HasFailed() const {
+		return failed;
+	}
+};
+
+// read only memory mapping of a whole file
+class MappedFile {
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator =(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	const char* GetData() const {
+		return data;
+	}
+
+	size_t GetSize() const {
+		return size;
+	}
+};
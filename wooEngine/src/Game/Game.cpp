@@ -16,6 +16,7 @@
 #include "../Systems/RenderHealthBarSystem.h"
 #include "../Systems/RenderGUISystem.h"
 #include "../Systems/ScriptSystem.h"
+#include "../Systems/HierarchySystem.h"
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_render.h>
@@ -37,9 +38,14 @@ int Game::mapHeight;
 Game::Game() {
 	isRunning = false;
 	isDebug = false;
+	millisecsPreviousCompact = 0;
 	registry = std::make_unique<Registry>();
 	assetStore = std::make_unique<AssetStore>();
 	eventBus = std::make_unique<EventBus>();
+	threadPool = std::make_unique<ThreadPool>(static_cast<int>(std::thread::hardware_concurrency()) - 1);
+	scheduler = std::make_unique<SystemScheduler>(*registry, *threadPool);
+	registry->SetThreadPool(threadPool.get());
+	frameArena = std::make_unique<FrameArena>();
 	Logger::Log("Game constructor called.");
 }
 
@@ -146,6 +152,14 @@ void Game::ProcessInput() {
 			if (sdlEvent.key.keysym.sym == SDLK_F1) {	//toggle debug mode
 				isDebug = !isDebug;
 			}
+			if (sdlEvent.key.keysym.sym == SDLK_F5) {	//quick save
+				registry->SaveSnapshot(SNAPSHOT_PATH);
+			}
+			if (sdlEvent.key.keysym.sym == SDLK_F9) {	//quick load
+				registry->LoadSnapshot(SNAPSHOT_PATH);
+				registry->GetSystem<HierarchySystem>().Invalidate();
+				registry->GetSystem<CollisionSystem>().InvalidateStatics();
+			}
 			eventBus->EmitEvent<KeyPressedEvent>(sdlEvent.key.keysym.sym);
 			break;
 		}
@@ -168,16 +182,165 @@ void Game::Setup() {
 	registry->AddSystem<RenderHealthBarSystem>();
 	registry->AddSystem<RenderGUISystem>();
 	registry->AddSystem<ScriptSystem>();
+	registry->AddSystem<HierarchySystem>();
+
+	// subscribe to events once, resubscribing every frame reallocated every handler
+	registry->GetSystem<MovementSystem>().SubscribeToEvents(eventBus);
+	registry->GetSystem<DamageSystem>().SubscribeToEvents(eventBus);
+	registry->GetSystem<KeyboardControlSystem>().SubscribeToEvents(eventBus);
+	registry->GetSystem<ProjectileEmitSystem>().SubscribeToEvents(eventBus);
+
+	// parent and children changes rebuild the hierarchy order, static collider changes the static tree
+	registry->GetSystem<HierarchySystem>().SubscribeToChanges(registry);
+	registry->GetSystem<CollisionSystem>().SubscribeToChanges(registry);
+
+	// enemies and projectiles never react to their own kind, those pairs are dropped in the broadphase
+	const int enemiesLayer = CollisionLayers::Intern("enemies");
+	const int projectilesLayer = CollisionLayers::Intern("projectiles");
+	registry->GetSystem<CollisionSystem>().SetLayersInteract(enemiesLayer, enemiesLayer, false);
+	registry->GetSystem<CollisionSystem>().SetLayersInteract(projectilesLayer, projectilesLayer, false);
+
+	// create owning groups up front, systems may first use them from worker threads
+	registry->Group<TransformComponent, RigidBodyComponent>();
 
 	// create lua bindings
 	registry->GetSystem<ScriptSystem>().CreateLuaBindings(lua);
 
+	RegisterSnapshotComponents();
+
 	LevelLoader loader;
 	lua.open_libraries(sol::lib::base, sol::lib::math);
 	loader.LoadLevel(lua, registry, assetStore, renderer, 1);
 }
 
+void Game::RegisterSnapshotComponents() {
+	// plain data components are copied as raw pool blocks
+	registry->RegisterSnapshotComponent<TransformComponent>();
+	registry->RegisterSnapshotComponent<RigidBodyComponent>();
+	registry->RegisterSnapshotComponent<AnimationComponent>();
+	registry->RegisterSnapshotComponent<KeyboardControllerComponent>();
+	registry->RegisterSnapshotComponent<CameraFollowComponent>();
+	registry->RegisterSnapshotComponent<HealthComponent>();
+	registry->RegisterSnapshotComponent<ProjectileEmitterComponent>();
+	registry->RegisterSnapshotComponent<ProjectileComponent>();
+	registry->RegisterSnapshotComponent<ParentComponent>();
+	registry->RegisterSnapshotComponent<StaticBodyComponent>();
+
+	// components holding strings store them length prefixed, asset ids are resolved by the asset store as usual
+	registry->RegisterSnapshotComponent<SpriteComponent>(
+		[](const SpriteComponent& sprite, SnapshotWriter& writer) {
+			writer.WriteString(sprite.assetId);
+			writer.Write(sprite.width);
+			writer.Write(sprite.height);
+			writer.Write(sprite.zIndex);
+			writer.Write(sprite.flip);
+			writer.Write(sprite.isFixed);
+			writer.Write(sprite.srcRect);
+		},
+		[](SnapshotReader& reader) {
+			SpriteComponent sprite;
+			reader.ReadString(sprite.assetId);
+			reader.Read(sprite.width);
+			reader.Read(sprite.height);
+			reader.Read(sprite.zIndex);
+			reader.Read(sprite.flip);
+			reader.Read(sprite.isFixed);
+			reader.Read(sprite.srcRect);
+			return sprite;
+		});
+
+	// collision layer ids depend on interning order, so colliders store the names of their layer and mask
+	registry->RegisterSnapshotComponent<BoxColliderComponent>(
+		[](const BoxColliderComponent& collider, SnapshotWriter& writer) {
+			writer.Write(collider.width);
+			writer.Write(collider.height);
+			writer.Write(collider.offset);
+			writer.WriteString(CollisionLayers::GetName(collider.layer));
+
+			// an all layers mask stays all layers, including layers named after loading
+			const bool isMaskAll = collider.mask == COLLISION_MASK_ALL;
+			writer.Write(isMaskAll);
+			if (!isMaskAll) {
+				std::vector<std::string> maskNames;
+				for (int layer = 0; layer < CollisionLayers::GetNumLayers(); layer++) {
+					if ((collider.mask >> layer) & 1) {
+						maskNames.push_back(CollisionLayers::GetName(layer));
+					}
+				}
+				writer.Write(static_cast<uint32_t>(maskNames.size()));
+				for (const auto& name : maskNames) {
+					writer.WriteString(name);
+				}
+			}
+		},
+		[](SnapshotReader& reader) {
+			BoxColliderComponent collider;
+			std::string layerName;
+			reader.Read(collider.width);
+			reader.Read(collider.height);
+			reader.Read(collider.offset);
+			reader.ReadString(layerName);
+			collider.layer = CollisionLayers::Intern(layerName);
+
+			bool isMaskAll = true;
+			reader.Read(isMaskAll);
+			if (!isMaskAll) {
+				uint32_t numMaskNames = 0;
+				reader.Read(numMaskNames);
+				std::vector<std::string> maskNames;
+				std::string name;
+				for (uint32_t i = 0; i < numMaskNames && reader.ReadString(name); i++) {
+					maskNames.push_back(name);
+				}
+				collider.mask = CollisionLayers::GetMask(maskNames);
+			}
+			return collider;
+		});
+
+	registry->RegisterSnapshotComponent<TextLabelComponent>(
+		[](const TextLabelComponent& label, SnapshotWriter& writer) {
+			writer.Write(label.position);
+			writer.WriteString(label.text);
+			writer.WriteString(label.assetId);
+			writer.Write(label.color);
+			writer.Write(label.isFixed);
+		},
+		[](SnapshotReader& reader) {
+			TextLabelComponent label;
+			reader.Read(label.position);
+			reader.ReadString(label.text);
+			reader.ReadString(label.assetId);
+			reader.Read(label.color);
+			reader.Read(label.isFixed);
+			return label;
+		});
+
+	// scripts are stored as lua bytecode, upvalues other than the globals are not restored
+	registry->RegisterSnapshotComponent<ScriptComponent>(
+		[](const ScriptComponent& script, SnapshotWriter& writer) {
+			const sol::bytecode bytecode = script.func.valid() ? script.func.dump() : sol::bytecode();
+			const auto code = bytecode.as_string_view();
+			writer.WriteString(std::string(code.data(), code.size()));
+		},
+		[this](SnapshotReader& reader) {
+			std::string code;
+			reader.ReadString(code);
+			if (code.empty()) {
+				return ScriptComponent();
+			}
+			sol::load_result script = lua.load(code, "snapshot script", sol::load_mode::binary);
+			if (!script.valid()) {
+				Logger::Err("Could not restore script from snapshot.");
+				return ScriptComponent();
+			}
+			return ScriptComponent(script.get<sol::function>());
+		});
+}
+
 void Game::Update() {
+	// scratch memory of the frame before last is reused
+	frameArena->BeginFrame();
+
 	// wait until current frame has passed into next frame to execute (framerate cap)
 	int timeToWait = MILLISECS_PER_FRAME - (SDL_GetTicks() - millisecsPreviousFrame);
 	if (timeToWait > 0 && timeToWait <= MILLISECS_PER_FRAME) {
@@ -190,26 +353,26 @@ void Game::Update() {
 	// current frame time
 	millisecsPreviousFrame = SDL_GetTicks();
 	
-	// reset all event handlers for current frame
-	eventBus->Reset();
-
-	// subscribe to events for all systems for current frame
-	registry->GetSystem<MovementSystem>().SubscribeToEvents(eventBus);
-	registry->GetSystem<DamageSystem>().SubscribeToEvents(eventBus);
-	registry->GetSystem<KeyboardControlSystem>().SubscribeToEvents(eventBus);
-	registry->GetSystem<ProjectileEmitSystem>().SubscribeToEvents(eventBus);
-
 	// update registry to process entities
 	registry->Update();
 
+	// release pool memory no longer needed, nothing iterates the pools between updates
+	if (SDL_GetTicks() - millisecsPreviousCompact > POOL_COMPACT_INTERVAL) {
+		registry->Compact();
+		millisecsPreviousCompact = SDL_GetTicks();
+	}
+
 	// invoke systems that need to update
-	registry->GetSystem<MovementSystem>().Update(deltaTime);
-	registry->GetSystem<AnimationSystem>().Update();
-	registry->GetSystem<CollisionSystem>().Update(eventBus);
-	registry->GetSystem<CameraMovementSystem>().Update(camera);
-	registry->GetSystem<ProjectileEmitSystem>().Update(registry);
-	registry->GetSystem<ProjectileLifecycleSystem>().Update();
-	registry->GetSystem<ScriptSystem>().Update(deltaTime, SDL_GetTicks());
+	// systems without conflicting component access run in parallel, in this order otherwise
+	scheduler->Schedule<MovementSystem>([&]() { registry->GetSystem<MovementSystem>().Update(registry, deltaTime); });
+	scheduler->Schedule<AnimationSystem>([&]() { registry->GetSystem<AnimationSystem>().Update(registry); });
+	scheduler->Schedule<ProjectileLifecycleSystem>([&]() { registry->GetSystem<ProjectileLifecycleSystem>().Update(); });
+	scheduler->Schedule<CameraMovementSystem>([&]() { registry->GetSystem<CameraMovementSystem>().Update(camera); });
+	scheduler->Schedule<ProjectileEmitSystem>([&]() { registry->GetSystem<ProjectileEmitSystem>().Update(registry, *frameArena); });
+	scheduler->Schedule<HierarchySystem>([&]() { registry->GetSystem<HierarchySystem>().Update(); });
+	scheduler->Schedule<CollisionSystem>([&]() { registry->GetSystem<CollisionSystem>().Update(eventBus); });
+	scheduler->Schedule<ScriptSystem>([&]() { registry->GetSystem<ScriptSystem>().Update(deltaTime, SDL_GetTicks()); });
+	scheduler->Run();
 }
 
 void Game::Render() {
@@ -217,13 +380,13 @@ void Game::Render() {
 	SDL_RenderClear(renderer);
 
 	// invoke systems that need to render
-	registry->GetSystem<RenderSystem>().Update(renderer, assetStore, camera);
+	registry->GetSystem<RenderSystem>().Update(registry, renderer, assetStore, camera, *frameArena);
 	registry->GetSystem<RenderTextSystem>().Update(renderer, assetStore, camera);
 	
 	if (isDebug) {
 		registry->GetSystem<RenderColliderSystem>().Update(renderer, camera);
 		registry->GetSystem<RenderHealthBarSystem>().Update(renderer, assetStore, camera);
-		registry->GetSystem<RenderGUISystem>().Update(renderer, registry, camera);
+		registry->GetSystem<RenderGUISystem>().Update(renderer, registry, camera, scheduler->GetLastReport(), *frameArena);
 	}
 
 	SDL_RenderPresent(renderer);
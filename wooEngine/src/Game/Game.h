@@ -3,12 +3,21 @@
 #include "../ECS/ECS.h"
 #include "../AssetStore/AssetStore.h"
 #include "../EventBus/EventBus.h"
+#include "../Scheduler/ThreadPool.h"
+#include "../Scheduler/SystemScheduler.h"
+#include "../Memory/FrameArena.h"
 #include <SDL.h>
 #include <sol/sol.hpp>
 
 const int FPS = 60;
 const int MILLISECS_PER_FRAME = 1000 / FPS;
 
+// pools left mostly empty (ie: after a wave of enemies died) are shrunk this often
+const int POOL_COMPACT_INTERVAL = 10000;
+
+// F5 saves the world to this file, F9 restores it
+const std::string SNAPSHOT_PATH = "./snapshot.bin";
+
 class Game {
 private:
 	bool isRunning;
@@ -17,12 +26,18 @@ private:
 	SDL_Renderer* renderer;
 	SDL_Rect camera;
 	int millisecsPreviousFrame;
+	int millisecsPreviousCompact;
 
 	sol::state lua;
 	
 	std::unique_ptr<Registry> registry;
 	std::unique_ptr<AssetStore> assetStore;
 	std::unique_ptr<EventBus> eventBus;
+	std::unique_ptr<ThreadPool> threadPool;
+	std::unique_ptr<SystemScheduler> scheduler;
+	std::unique_ptr<FrameArena> frameArena;
+
+	void RegisterSnapshotComponents();
 
 public:
 	Game();
@@ -10,12 +10,17 @@
 #include "../Components/KeyboardControllerComponent.h"
 #include "../Components/CameraFollowComponent.h"
 #include "../Components/ProjectileEmitterComponent.h"
+#include "../Components/ProjectileComponent.h"
 #include "../Components/HealthComponent.h"
 #include "../Components/TextLabelComponent.h"
 #include "../Components/ScriptComponent.h"
+#include "../Components/ParentComponent.h"
+#include "../Components/StaticBodyComponent.h"
+#include "../Systems/CollisionSystem.h"
 #include <string>
 #include <memory>
 #include <fstream>
+#include <unordered_map>
 
 LevelLoader::LevelLoader() {
 	Logger::Log("LevelLoader constructor called.");
@@ -63,6 +68,41 @@ void LevelLoader::LoadLevel(sol::state& lua, const std::unique_ptr<Registry>& re
 		i++;
 	}
 
+	// reserve pool capacity for the entities the level expects, keyed like entity components
+	// ie: pools = { transform = 2000, sprite = 2000, projectile = 500 }
+	sol::optional<sol::table> hasPools = level["pools"];
+	if (hasPools != sol::nullopt) {
+		sol::table pools = hasPools.value();
+		registry->Reserve<TransformComponent>(pools["transform"].get_or(0));
+		registry->Reserve<RigidBodyComponent>(pools["rigidbody"].get_or(0));
+		registry->Reserve<SpriteComponent>(pools["sprite"].get_or(0));
+		registry->Reserve<AnimationComponent>(pools["animation"].get_or(0));
+		registry->Reserve<BoxColliderComponent>(pools["boxcollider"].get_or(0));
+		registry->Reserve<HealthComponent>(pools["health"].get_or(0));
+		registry->Reserve<ProjectileEmitterComponent>(pools["projectile_emitter"].get_or(0));
+		registry->Reserve<ProjectileComponent>(pools["projectile"].get_or(0));
+		registry->Reserve<ScriptComponent>(pools["on_update_script"].get_or(0));
+	}
+
+	// collision broadphase settings
+	// ie: collision = { broadphase = "tree", cell_size = 64, tree_margin = 8 }
+	sol::optional<sol::table> hasCollision = level["collision"];
+	if (hasCollision != sol::nullopt && registry->HasSystem<CollisionSystem>()) {
+		CollisionSystem& collisionSystem = registry->GetSystem<CollisionSystem>();
+		collisionSystem.SetBroadphase(level["collision"]["broadphase"].get_or(std::string("grid")));
+		collisionSystem.SetCellSize(level["collision"]["cell_size"].get_or(DEFAULT_COLLISION_CELL_SIZE));
+		collisionSystem.SetTreeMargin(level["collision"]["tree_margin"].get_or(DEFAULT_AABB_TREE_MARGIN));
+
+		// pairs of layers that never collide, ie: ignore = { { "enemies", "enemies" } }
+		sol::optional<sol::table> hasIgnore = level["collision"]["ignore"];
+		if (hasIgnore != sol::nullopt) {
+			for (const auto& ignored : hasIgnore.value()) {
+				sol::table layers = ignored.second;
+				collisionSystem.SetLayersInteract(CollisionLayers::Intern(layers[1].get<std::string>()), CollisionLayers::Intern(layers[2].get<std::string>()), false);
+			}
+		}
+	}
+
 	// read tilemap
 	sol::table map = level["tilemap"];
 	std::string mapFilePath = map["map_file"];
@@ -75,6 +115,9 @@ void LevelLoader::LoadLevel(sol::state& lua, const std::unique_ptr<Registry>& re
 	std::fstream mapFile;
 	mapFile.open(mapFilePath);
 
+	// source rect of each tile, row by row
+	std::vector<glm::ivec2> tileSrcRects;
+	tileSrcRects.reserve(mapNumRows * mapNumCols);
 	for (int y = 0; y < mapNumRows; y++) {
 		for (int x = 0; x < mapNumCols; x++) {
 			char ch;
@@ -84,19 +127,49 @@ void LevelLoader::LoadLevel(sol::state& lua, const std::unique_ptr<Registry>& re
 			int srcRectX = std::atoi(&ch) * tileSize;
 			mapFile.ignore();
 
-			Entity tile = registry->CreateEntity();
-			tile.Group("tiles");
-			tile.AddComponent<TransformComponent>(glm::vec2(x * tileSize * tileScale, y * tileSize * tileScale), glm::vec2(tileScale, tileScale));
-			tile.AddComponent<SpriteComponent>(mapTextureAssetId, tileSize, tileSize, 0, false, srcRectX, srcRectY);
+			tileSrcRects.push_back(glm::ivec2(srcRectX, srcRectY));
 		}
 	}
 	mapFile.close();
+
+	// every tile is created from one prefab in a single batch
+	Prefab tilePrefab;
+	tilePrefab
+		.Add<TransformComponent>(glm::vec2(0.0, 0.0), glm::vec2(tileScale, tileScale))
+		.Add<SpriteComponent>(mapTextureAssetId, tileSize, tileSize, 0, false)
+		.Group("tiles");
+
+	registry->Instantiate(tilePrefab, mapNumRows * mapNumCols, [&](Entity tile, int index) {
+		const int x = index % mapNumCols;
+		const int y = index / mapNumCols;
+		tile.GetComponent<TransformComponent>().position = glm::vec2(x * tileSize * tileScale, y * tileSize * tileScale);
+		auto& sprite = tile.GetComponent<SpriteComponent>();
+		sprite.srcRect.x = tileSrcRects[index].x;
+		sprite.srcRect.y = tileSrcRects[index].y;
+	});
 	Game::mapWidth = mapNumCols * tileSize * tileScale;
 	Game::mapHeight = mapNumRows * tileSize * tileScale;
 
+	// read prefabs, entities can start from a prefab and override its components
+	sol::optional<sol::table> hasPrefabs = level["prefabs"];
+	if (hasPrefabs != sol::nullopt) {
+		for (const auto& definition : hasPrefabs.value()) {
+			const std::string name = definition.first.as<std::string>();
+			sol::table prefabTable = definition.second;
+
+			Prefab prefab;
+			ReadPrefab(prefabTable, prefab);
+			registry->SetPrefab(name, prefab);
+			Logger::Log("New prefab loaded, name: " + name);
+		}
+	}
+
 	// read entities and components
 	sol::table entities = level["entities"];
 
+	// tagged entities created so far, entities can attach to an earlier one as its child
+	std::unordered_map<std::string, Entity> taggedEntities;
+
 	i = 0;
 	while (true) {
 		sol::optional<sol::table> hasEntity = entities[i];
@@ -105,147 +178,212 @@ void LevelLoader::LoadLevel(sol::state& lua, const std::unique_ptr<Registry>& re
 		}
 
 		sol::table entity = entities[i];
-		
-		Entity newEntity = registry->CreateEntity();
+
+		Prefab prefab;
+		sol::optional<std::string> hasPrefab = entity["prefab"];
+		if (hasPrefab != sol::nullopt) {
+			const Prefab* basePrefab = registry->FindPrefab(hasPrefab.value());
+			if (basePrefab) {
+				prefab = *basePrefab;
+			}
+			else {
+				Logger::Err("Entity " + std::to_string(i) + " uses unknown prefab " + hasPrefab.value());
+			}
+		}
+		ReadPrefab(entity, prefab);
+
+		Entity newEntity = registry->Instantiate(prefab);
 
 		// tag entity
 		sol::optional<std::string> hasTag = entity["tag"];
 		if (hasTag != sol::nullopt) {
-			newEntity.Tag(entity["tag"]);
+			newEntity.Tag(hasTag.value());
+			taggedEntities.emplace(hasTag.value(), newEntity);
 		}
 
-		// add entity to group
-		sol::optional<std::string> hasGroup = entity["group"];
-		if (hasGroup != sol::nullopt) {
-			newEntity.Group(entity["group"]);
-		}
-
-		// add components
-		sol::optional<sol::table> hasComponents = entity["components"];
-		if (hasComponents != sol::nullopt) {
-			// transform component
-			sol::optional<sol::table> hasTransform = entity["components"]["transform"];
-			if (hasTransform != sol::nullopt) {
-				newEntity.AddComponent<TransformComponent>(
+		// attach to parent, the transform component then holds the world transform
+		sol::optional<sol::table> hasParent = entity["parent"];
+		if (hasParent != sol::nullopt) {
+			const std::string parentTag = entity["parent"]["tag"];
+			auto parent = taggedEntities.find(parentTag);
+			if (parent != taggedEntities.end()) {
+				newEntity.AddComponent<ParentComponent>(
+					parent->second,
 					glm::vec2(
-						entity["components"]["transform"]["position"]["x"],
-						entity["components"]["transform"]["position"]["y"]
-						),
+						entity["parent"]["local_position"]["x"].get_or(0.0),
+						entity["parent"]["local_position"]["y"].get_or(0.0)
+					),
 					glm::vec2(
-						entity["components"]["transform"]["scale"]["x"].get_or(1.0),
-						entity["components"]["transform"]["scale"]["y"].get_or(1.0)
-						),
-					entity["components"]["transform"]["rotation"].get_or(0.0)
-					);
+						entity["parent"]["local_scale"]["x"].get_or(1.0),
+						entity["parent"]["local_scale"]["y"].get_or(1.0)
+					),
+					entity["parent"]["local_rotation"].get_or(0.0)
+				);
 			}
-
-			// rigidbody component
-			sol::optional<sol::table> hasRigidBody = entity["components"]["rigidbody"];
-			if (hasRigidBody != sol::nullopt) {
-				newEntity.AddComponent<RigidBodyComponent>(
-					glm::vec2(
-						entity["components"]["rigidbody"]["velocity"]["x"].get_or(0.0),
-						entity["components"]["rigidbody"]["velocity"]["y"].get_or(0.0)
-						)
-					);
+			else {
+				Logger::Err("Entity " + std::to_string(i) + " has unknown parent tag " + parentTag);
 			}
+		}
 
-			// sprite component
-			sol::optional<sol::table> hasSprite = entity["components"]["sprite"];
-			if (hasSprite != sol::nullopt) {
-				newEntity.AddComponent<SpriteComponent>(
-					entity["components"]["sprite"]["texture_asset_id"],
-					entity["components"]["sprite"]["width"],
-					entity["components"]["sprite"]["height"],
-					entity["components"]["sprite"]["z_index"].get_or(1),
-					entity["components"]["sprite"]["fixed"].get_or(false),
-					entity["components"]["sprite"]["src_rect_x"].get_or(0),
-					entity["components"]["sprite"]["src_rect_y"].get_or(0)
-					);
-			}
+		i++;
+	}
+}
 
-			// animation component
-			sol::optional<sol::table> hasAnimation = entity["components"]["animation"];
-			if (hasAnimation != sol::nullopt) {
-				newEntity.AddComponent<AnimationComponent>(
-					entity["components"]["animation"]["num_frames"].get_or(1),
-					entity["components"]["animation"]["speed_rate"].get_or(1)
-					);
-			}
+void LevelLoader::ReadPrefab(sol::table entity, Prefab& prefab) {
+	// add entity to group, replacing the group of its prefab like components replace theirs
+	sol::optional<std::string> hasGroup = entity["group"];
+	if (hasGroup != sol::nullopt) {
+		prefab.ClearGroups().Group(hasGroup.value());
+	}
 
-			// boxcollider component
-			sol::optional<sol::table> hasCollider = entity["components"]["boxcollider"];
-			if (hasCollider != sol::nullopt) {
-				newEntity.AddComponent<BoxColliderComponent>(
-					entity["components"]["boxcollider"]["width"],
-					entity["components"]["boxcollider"]["height"],
-					glm::vec2(
-						entity["components"]["boxcollider"]["offset"]["x"].get_or(0),
-						entity["components"]["boxcollider"]["offset"]["y"].get_or(0)
-						)
-					);
-			}
+	// add components
+	sol::optional<sol::table> hasComponents = entity["components"];
+	if (hasComponents != sol::nullopt) {
+		// transform component
+		sol::optional<sol::table> hasTransform = entity["components"]["transform"];
+		if (hasTransform != sol::nullopt) {
+			prefab.Add<TransformComponent>(
+				glm::vec2(
+					entity["components"]["transform"]["position"]["x"],
+					entity["components"]["transform"]["position"]["y"]
+					),
+				glm::vec2(
+					entity["components"]["transform"]["scale"]["x"].get_or(1.0),
+					entity["components"]["transform"]["scale"]["y"].get_or(1.0)
+					),
+				entity["components"]["transform"]["rotation"].get_or(0.0)
+				);
+		}
 
-			// health component
-			sol::optional<sol::table> hasHealth = entity["components"]["health"];
-			if (hasHealth != sol::nullopt) {
-				newEntity.AddComponent<HealthComponent>(
-					static_cast<int>(entity["components"]["health"]["health_val"].get_or(100))
-					);
-			}
+		// rigidbody component
+		sol::optional<sol::table> hasRigidBody = entity["components"]["rigidbody"];
+		if (hasRigidBody != sol::nullopt) {
+			prefab.Add<RigidBodyComponent>(
+				glm::vec2(
+					entity["components"]["rigidbody"]["velocity"]["x"].get_or(0.0),
+					entity["components"]["rigidbody"]["velocity"]["y"].get_or(0.0)
+					)
+				);
+		}
 
-			// projectileemitter component
-			sol::optional<sol::table> hasProjectileEmitter = entity["components"]["projectile_emitter"];
-			if (hasProjectileEmitter != sol::nullopt) {
-				newEntity.AddComponent<ProjectileEmitterComponent>(
-					glm::vec2(
-						entity["components"]["projectile_emitter"]["projectile_velocity"]["x"],
-						entity["components"]["projectile_emitter"]["projectile_velocity"]["y"]
-						),
-					entity["components"]["projectile_emitter"]["repeat_frequency"].get_or(1) * 1000,
-					entity["components"]["projectile_emitter"]["projectile_duration"].get_or(10000) * 10000,
-					static_cast<int>(entity["components"]["projectile_emitter"]["hit_damage"].get_or(10)),
-					entity["components"]["projectile_emitter"]["friendly"].get_or(false)
-					);
-			}
+		// sprite component
+		sol::optional<sol::table> hasSprite = entity["components"]["sprite"];
+		if (hasSprite != sol::nullopt) {
+			prefab.Add<SpriteComponent>(
+				entity["components"]["sprite"]["texture_asset_id"],
+				entity["components"]["sprite"]["width"],
+				entity["components"]["sprite"]["height"],
+				entity["components"]["sprite"]["z_index"].get_or(1),
+				entity["components"]["sprite"]["fixed"].get_or(false),
+				entity["components"]["sprite"]["src_rect_x"].get_or(0),
+				entity["components"]["sprite"]["src_rect_y"].get_or(0)
+				);
+		}
 
-			// camerafollow component
-			sol::optional<sol::table> hasCameraFollow = entity["components"]["camera_follow"];
-			if (hasCameraFollow != sol::nullopt) {
-				newEntity.AddComponent<CameraFollowComponent>();
-			}
+		// animation component
+		sol::optional<sol::table> hasAnimation = entity["components"]["animation"];
+		if (hasAnimation != sol::nullopt) {
+			prefab.Add<AnimationComponent>(
+				entity["components"]["animation"]["num_frames"].get_or(1),
+				entity["components"]["animation"]["speed_rate"].get_or(1)
+				);
+		}
 
-			// keyboardcontroller component
-			sol::optional<sol::table> hasKeyboardController = entity["components"]["keyboard_controller"];
-			if (hasKeyboardController != sol::nullopt) {
-				newEntity.AddComponent<KeyboardControllerComponent>(
-					glm::vec2(
-						entity["components"]["keyboard_controller"]["up_velocity"]["x"],
-						entity["components"]["keyboard_controller"]["up_velocity"]["y"]
-						),
-					glm::vec2(
-						entity["components"]["keyboard_controller"]["right_velocity"]["x"],
-						entity["components"]["keyboard_controller"]["right_velocity"]["y"]
-						),
-					glm::vec2(
-						entity["components"]["keyboard_controller"]["down_velocity"]["x"],
-						entity["components"]["keyboard_controller"]["down_velocity"]["y"]
-						),
-					glm::vec2(
-						entity["components"]["keyboard_controller"]["left_velocity"]["x"],
-						entity["components"]["keyboard_controller"]["left_velocity"]["y"]
-						)
-					);
+		// boxcollider component
+		sol::optional<sol::table> hasCollider = entity["components"]["boxcollider"];
+		if (hasCollider != sol::nullopt) {
+			// the layer defaults to the entity's group, or its prefab's when only the collider is overridden,
+			// the mask to every layer
+			// ie: boxcollider = { width = 4, height = 4, layer = "projectiles", mask = { "player", "enemies" } }
+			int layer = DEFAULT_COLLISION_LAYER;
+			sol::optional<std::string> hasLayer = entity["components"]["boxcollider"]["layer"];
+			if (hasLayer != sol::nullopt) {
+				layer = CollisionLayers::Intern(hasLayer.value());
+			} else if (!prefab.GetGroups().empty()) {
+				layer = CollisionLayers::Intern(Registry::GetGroupName(prefab.GetGroups().front()));
 			}
 
-			// scripts
-			sol::optional<sol::table> script = entity["components"]["on_update_script"];
-			if (script != sol::nullopt) {
-				sol::function func = entity["components"]["on_update_script"][0];
-				newEntity.AddComponent<ScriptComponent>(func);
+			uint32_t mask = COLLISION_MASK_ALL;
+			sol::optional<std::vector<std::string>> hasMask = entity["components"]["boxcollider"]["mask"];
+			if (hasMask != sol::nullopt) {
+				mask = CollisionLayers::GetMask(hasMask.value());
 			}
+
+			prefab.Add<BoxColliderComponent>(
+				entity["components"]["boxcollider"]["width"],
+				entity["components"]["boxcollider"]["height"],
+				glm::vec2(
+					entity["components"]["boxcollider"]["offset"]["x"].get_or(0),
+					entity["components"]["boxcollider"]["offset"]["y"].get_or(0)
+					),
+				layer,
+				mask
+				);
 		}
 
-		i++;
+		// health component
+		sol::optional<sol::table> hasHealth = entity["components"]["health"];
+		if (hasHealth != sol::nullopt) {
+			prefab.Add<HealthComponent>(
+				static_cast<int>(entity["components"]["health"]["health_val"].get_or(100))
+				);
+		}
+
+		// projectileemitter component
+		sol::optional<sol::table> hasProjectileEmitter = entity["components"]["projectile_emitter"];
+		if (hasProjectileEmitter != sol::nullopt) {
+			prefab.Add<ProjectileEmitterComponent>(
+				glm::vec2(
+					entity["components"]["projectile_emitter"]["projectile_velocity"]["x"],
+					entity["components"]["projectile_emitter"]["projectile_velocity"]["y"]
+					),
+				entity["components"]["projectile_emitter"]["repeat_frequency"].get_or(1) * 1000,
+				entity["components"]["projectile_emitter"]["projectile_duration"].get_or(10000) * 10000,
+				static_cast<int>(entity["components"]["projectile_emitter"]["hit_damage"].get_or(10)),
+				entity["components"]["projectile_emitter"]["friendly"].get_or(false)
+				);
+		}
+
+		// camerafollow component
+		sol::optional<sol::table> hasCameraFollow = entity["components"]["camera_follow"];
+		if (hasCameraFollow != sol::nullopt) {
+			prefab.Add<CameraFollowComponent>();
+		}
+
+		// static body component, ie: static_body = {} on obstacles that never move
+		sol::optional<sol::table> hasStaticBody = entity["components"]["static_body"];
+		if (hasStaticBody != sol::nullopt) {
+			prefab.Add<StaticBodyComponent>();
+		}
+
+		// keyboardcontroller component
+		sol::optional<sol::table> hasKeyboardController = entity["components"]["keyboard_controller"];
+		if (hasKeyboardController != sol::nullopt) {
+			prefab.Add<KeyboardControllerComponent>(
+				glm::vec2(
+					entity["components"]["keyboard_controller"]["up_velocity"]["x"],
+					entity["components"]["keyboard_controller"]["up_velocity"]["y"]
+					),
+				glm::vec2(
+					entity["components"]["keyboard_controller"]["right_velocity"]["x"],
+					entity["components"]["keyboard_controller"]["right_velocity"]["y"]
+					),
+				glm::vec2(
+					entity["components"]["keyboard_controller"]["down_velocity"]["x"],
+					entity["components"]["keyboard_controller"]["down_velocity"]["y"]
+					),
+				glm::vec2(
+					entity["components"]["keyboard_controller"]["left_velocity"]["x"],
+					entity["components"]["keyboard_controller"]["left_velocity"]["y"]
+					)
+				);
+		}
+
+		// scripts
+		sol::optional<sol::table> script = entity["components"]["on_update_script"];
+		if (script != sol::nullopt) {
+			sol::function func = entity["components"]["on_update_script"][0];
+			prefab.Add<ScriptComponent>(func);
+		}
 	}
 }
\ No newline at end of file
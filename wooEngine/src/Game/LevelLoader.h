@@ -6,6 +6,10 @@
 #include <sol/sol.hpp>
 
 class LevelLoader {
+private:
+	// adds the group and components defined in a level table to a prefab
+	void ReadPrefab(sol::table entity, Prefab& prefab);
+
 public:
 	LevelLoader();
 	~LevelLoader();
@@ -2,31 +2,245 @@
 #include <iostream>
 #include <chrono>
 #include <ctime>
-#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-std::vector<LogEntry> Logger::messages;
+namespace {
+	// number of messages that can wait for the writer thread, a power of two
+	const size_t LOG_QUEUE_SIZE = 8192;
 
-std::string ThisDateTimeToString() {
-	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-	std::string output(30, '\0');
-	std::strftime(&output[0], output.size(), "%d/%b/%Y %H:%M:%S", std::localtime(&now));
-	return output;
+	struct QueuedMessage {
+		LogType type;
+		std::string message;
+		std::chrono::system_clock::time_point time;
+	};
+
+	///////////////////////////////////////////////////
+	// LogQueue
+	///////////////////////////////////////////////////
+	// bounded lock free multi producer, single consumer ring buffer
+	// each cell carries a sequence number telling producers and the consumer whose turn it is
+	// a background thread drains it, formats timestamps and prints in batches
+	///////////////////////////////////////////////////
+
+	class LogQueue {
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			QueuedMessage entry;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		alignas(64) std::atomic<size_t> enqueuePosition = 0;
+		alignas(64) std::atomic<size_t> dequeuePosition = 0;
+
+		std::atomic<LogType> level = LOG_DEBUG;
+		std::atomic<bool> isRunning = true;
+
+		// dropped messages not reported yet, and in total
+		std::atomic<int> numDropped = 0;
+		std::atomic<int> numDroppedTotal = 0;
+
+		// messages printed so far, compared against enqueue positions by Flush
+		std::atomic<size_t> numWritten = 0;
+
+		std::mutex historyMutex;
+		std::deque<LogEntry> history;
+
+		// the date only changes once per second, so it is formatted once per second
+		std::time_t cachedSecond = 0;
+		std::string cachedDateTime;
+
+		std::thread writer;
+
+		bool TryDequeue(QueuedMessage& entry) {
+			const size_t position = dequeuePosition.load(std::memory_order_relaxed);
+			Cell& cell = cells[position & (LOG_QUEUE_SIZE - 1)];
+			if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+				return false;
+			}
+			entry = std::move(cell.entry);
+			cell.sequence.store(position + LOG_QUEUE_SIZE, std::memory_order_release);
+			dequeuePosition.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		const std::string& DateTimeToString(std::chrono::system_clock::time_point time) {
+			const std::time_t second = std::chrono::system_clock::to_time_t(time);
+			if (second != cachedSecond || cachedDateTime.empty()) {
+				char output[30] = {};
+				std::strftime(output, sizeof(output), "%d/%b/%Y %H:%M:%S", std::localtime(&second));
+				cachedDateTime = output;
+				cachedSecond = second;
+			}
+			return cachedDateTime;
+		}
+
+		// prints every queued message, returns false if the queue was empty
+		bool WriteQueuedMessages() {
+			static const char* prefixes[] = { "DBG | ", "LOG | ", "WRN | ", "ERR | " };
+			static const char* colors[] = { "\x1B[37m", "\x1B[32m", "\x1B[93m", "\x1B[91m" };	// ANSI esc seq: gray, green, yellow, red
+
+			std::string output;
+			std::vector<LogEntry> entries;
+			QueuedMessage queued;
+			while (TryDequeue(queued)) {
+				LogEntry entry;
+				entry.type = queued.type;
+				entry.message = prefixes[queued.type] + DateTimeToString(queued.time) + " - " + queued.message;
+				output += colors[queued.type] + entry.message + "\033[0m\n";
+				entries.push_back(std::move(entry));
+			}
+
+			const int dropped = numDropped.exchange(0);
+			if (dropped > 0) {
+				LogEntry entry;
+				entry.type = LOG_WARNING;
+				entry.message = prefixes[LOG_WARNING] + std::to_string(dropped) + " messages dropped, the log queue was full";
+				output += colors[LOG_WARNING] + entry.message + "\033[0m\n";
+				entries.push_back(std::move(entry));
+			}
+
+			if (entries.empty()) {
+				return false;
+			}
+
+			// one write and flush per batch instead of per message
+			std::cout << output << std::flush;
+
+			std::lock_guard<std::mutex> lock(historyMutex);
+			for (auto& entry : entries) {
+				history.push_back(std::move(entry));
+			}
+			while (history.size() > static_cast<size_t>(LOG_HISTORY_SIZE)) {
+				history.pop_front();
+			}
+			numWritten.fetch_add(entries.size() - (dropped > 0 ? 1 : 0), std::memory_order_release);
+			return true;
+		}
+
+		void RunWriter() {
+			while (isRunning.load(std::memory_order_acquire)) {
+				if (!WriteQueuedMessages()) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				}
+			}
+			WriteQueuedMessages();
+		}
+
+	public:
+		LogQueue() : cells(new Cell[LOG_QUEUE_SIZE]) {
+			for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			writer = std::thread(&LogQueue::RunWriter, this);
+		}
+
+		~LogQueue() {
+			isRunning.store(false, std::memory_order_release);
+			writer.join();
+		}
+
+		// never blocks, the message is dropped if the writer fell a full queue behind
+		void Enqueue(LogType type, std::string&& message) {
+			if (type < level.load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			size_t position = enqueuePosition.load(std::memory_order_relaxed);
+			Cell* cell;
+			while (true) {
+				cell = &cells[position & (LOG_QUEUE_SIZE - 1)];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+				if (difference == 0) {
+					// the cell is free, claim it
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (difference < 0) {
+					numDropped.fetch_add(1, std::memory_order_relaxed);
+					numDroppedTotal.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				else {
+					position = enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->entry.type = type;
+			cell->entry.message = std::move(message);
+			cell->entry.time = std::chrono::system_clock::now();
+			cell->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		void Flush() {
+			const size_t target = enqueuePosition.load(std::memory_order_acquire);
+			while (numWritten.load(std::memory_order_acquire) < target && isRunning.load(std::memory_order_acquire)) {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+
+		void SetLevel(LogType level) {
+			this->level.store(level, std::memory_order_relaxed);
+		}
+
+		std::vector<LogEntry> GetHistory() {
+			std::lock_guard<std::mutex> lock(historyMutex);
+			return std::vector<LogEntry>(history.begin(), history.end());
+		}
+
+		int GetNumDropped() const {
+			return numDroppedTotal.load(std::memory_order_relaxed);
+		}
+	};
+
+	// started on first use and stopped after main returns, printing what is left
+	LogQueue& GetQueue() {
+		static LogQueue queue;
+		return queue;
+	}
+}
+
+void Logger::Write(LogType type, std::string message) {
+	GetQueue().Enqueue(type, std::move(message));
+}
+
+void Logger::Debug(const std::string& message) {
+	Write(LOG_DEBUG, message);
 }
 
 void Logger::Log(const std::string& message) {
-	LogEntry logEntry;
-	logEntry.type = LOG_INFO;
-	logEntry.message = "LOG | " + ThisDateTimeToString() + " - " + message;
-	std::cout << "\x1B[32m" << logEntry.message << "\033[0m" << std::endl;	//print in green using ANSI esc seq
+	Write(LOG_INFO, message);
+}
 
-	messages.push_back(logEntry);
+void Logger::Warn(const std::string& message) {
+	Write(LOG_WARNING, message);
 }
 
 void Logger::Err(const std::string& message) {
-	LogEntry logEntry;
-	logEntry.type = LOG_ERROR;
-	logEntry.message = "ERR | " + ThisDateTimeToString() + " - " + message;
-	std::cout << "\x1B[91m" << logEntry.message << "\033[0m" << std::endl;	//print in red using ANSI esc seq
+	Write(LOG_ERROR, message);
+	Flush();
+}
+
+void Logger::SetLevel(LogType level) {
+	GetQueue().SetLevel(level);
+}
 
-	messages.push_back(logEntry);
-}
\ No newline at end of file
+void Logger::Flush() {
+	GetQueue().Flush();
+}
+
+std::vector<LogEntry> Logger::GetHistory() {
+	return GetQueue().GetHistory();
+}
+
+int Logger::GetNumDropped() {
+	return GetQueue().GetNumDropped();
+}
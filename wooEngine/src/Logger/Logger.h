@@ -3,19 +3,53 @@
 #include <vector>
 
 enum LogType {
+	LOG_DEBUG,
 	LOG_INFO,
 	LOG_WARNING,
 	LOG_ERROR
 };
 
+// messages below this level are compiled out of the WOO_LOG_* macros
+// 0 = debug, 1 = info, 2 = warning, 3 = error
+#ifndef WOO_LOG_LEVEL
+#define WOO_LOG_LEVEL 1
+#endif
+
 struct LogEntry {
 	LogType type;
 	std::string message;
 };
 
+// log calls only queue the message, a background thread formats and prints it
+// the last LOG_HISTORY_SIZE messages are kept for the debug console
+const int LOG_HISTORY_SIZE = 512;
+
 class Logger {
 public:
-	static std::vector<LogEntry> messages;
+	static void Debug(const std::string& message);
 	static void Log(const std::string& message);
+	static void Warn(const std::string& message);
+	// errors wait until they are printed, so they are not lost if the program crashes right after
 	static void Err(const std::string& message);
-};
\ No newline at end of file
+
+	static void Write(LogType type, std::string message);
+
+	// messages below the level are discarded at runtime
+	static void SetLevel(LogType level);
+
+	// blocks until every queued message is printed
+	static void Flush();
+
+	static std::vector<LogEntry> GetHistory();
+
+	// messages discarded because the queue was full
+	static int GetNumDropped();
+};
+
+// the message expression is not evaluated when the level is compiled out
+// ie: WOO_LOG_DEBUG("Entity created with id = " + std::to_string(entity.GetId()));
+#define WOO_LOG(type, message) do { if constexpr ((type) >= WOO_LOG_LEVEL) { Logger::Write((type), (message)); } } while (false)
+#define WOO_LOG_DEBUG(message) WOO_LOG(LOG_DEBUG, message)
+#define WOO_LOG_INFO(message) WOO_LOG(LOG_INFO, message)
+#define WOO_LOG_WARNING(message) WOO_LOG(LOG_WARNING, message)
+#define WOO_LOG_ERROR(message) WOO_LOG(LOG_ERROR, message)
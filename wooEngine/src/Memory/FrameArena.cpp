@@ -0,0 +1,82 @@
+#include "FrameArena.h"
+#include "../Logger/Logger.h"
+#include <algorithm>
+#include <cstdint>
+
+LinearArena::LinearArena(size_t capacity) : buffer(new char[capacity]), capacity(capacity) {
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+	const uintptr_t base = reinterpret_cast<uintptr_t>(buffer.get());
+	size_t current = offset.load(std::memory_order_relaxed);
+	while (true) {
+		const size_t aligned = ((base + current + alignment - 1) & ~(alignment - 1)) - base;
+		if (aligned + size > capacity) {
+			break;
+		}
+		if (offset.compare_exchange_weak(current, aligned + size, std::memory_order_relaxed)) {
+			return buffer.get() + aligned;
+		}
+	}
+
+	// out of space for this frame, counted so the buffer can grow on the next reset
+	std::lock_guard<std::mutex> lock(overflowMutex);
+	overflowBlocks.push_back(std::unique_ptr<char[]>(new char[size + alignment]));
+	numOverflowBytes += size + alignment;
+	const uintptr_t block = reinterpret_cast<uintptr_t>(overflowBlocks.back().get());
+	return reinterpret_cast<void*>((block + alignment - 1) & ~(alignment - 1));
+}
+
+void LinearArena::Reset() {
+	const size_t used = GetUsed();
+	highWaterMark = std::max(highWaterMark, used);
+
+	if (!overflowBlocks.empty()) {
+		size_t newCapacity = capacity;
+		while (newCapacity < used) {
+			newCapacity *= 2;
+		}
+		Logger::Warn("Frame arena grown from " + std::to_string(capacity) + " to " + std::to_string(newCapacity) + " bytes.");
+		buffer.reset(new char[newCapacity]);
+		capacity = newCapacity;
+		overflowBlocks.clear();
+		numOverflowBytes = 0;
+	}
+	offset.store(0, std::memory_order_relaxed);
+}
+
+size_t LinearArena::GetUsed() const {
+	return offset.load(std::memory_order_relaxed) + numOverflowBytes;
+}
+
+size_t LinearArena::GetCapacity() const {
+	return capacity;
+}
+
+size_t LinearArena::GetHighWaterMark() const {
+	return highWaterMark;
+}
+
+FrameArena::FrameArena(size_t capacity) : arenas{ capacity, capacity } {
+}
+
+void FrameArena::BeginFrame() {
+	currentArena = 1 - currentArena;
+	arenas[currentArena].Reset();
+}
+
+LinearArena& FrameArena::GetCurrent() {
+	return arenas[currentArena];
+}
+
+const LinearArena& FrameArena::GetCurrent() const {
+	return arenas[currentArena];
+}
+
+const LinearArena& FrameArena::GetPrevious() const {
+	return arenas[1 - currentArena];
+}
+
+size_t FrameArena::GetHighWaterMark() const {
+	return std::max(arenas[0].GetHighWaterMark(), arenas[1].GetHighWaterMark());
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+///////////////////////////////////////////////////
+// LinearArena
+///////////////////////////////////////////////////
+// bump allocator, memory is only released all at once by Reset
+// allocation is a single atomic add, so systems running in parallel may share it
+// requests that do not fit go to overflow blocks, and the next Reset grows the
+// buffer to the high-water mark so the same load fits without allocating again
+///////////////////////////////////////////////////
+
+class LinearArena {
+private:
+	std::unique_ptr<char[]> buffer;
+	size_t capacity;
+	std::atomic<size_t> offset = 0;
+
+	std::mutex overflowMutex;
+	std::vector<std::unique_ptr<char[]>> overflowBlocks;
+	size_t numOverflowBytes = 0;
+
+	size_t highWaterMark = 0;
+
+public:
+	LinearArena(size_t capacity);
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// allocates and default constructs count objects
+	// destructors are never run, so T should not own resources
+	template <typename T> T* New(size_t count);
+
+	// invalidates everything allocated since the last reset, not thread safe
+	void Reset();
+
+	size_t GetUsed() const;
+	size_t GetCapacity() const;
+	size_t GetHighWaterMark() const;
+};
+
+template <typename T>
+T* LinearArena::New(size_t count) {
+	T* objects = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	for (size_t i = 0; i < count; i++) {
+		new (&objects[i]) T();
+	}
+	return objects;
+}
+
+///////////////////////////////////////////////////
+// FrameAllocator
+///////////////////////////////////////////////////
+// stl allocator adaptor for a linear arena, deallocation does nothing
+// ie: FrameVector<Entity> entities(frameArena.GetAllocator<Entity>());
+///////////////////////////////////////////////////
+
+template <typename T>
+class FrameAllocator {
+public:
+	typedef T value_type;
+
+	LinearArena* arena;
+
+	FrameAllocator(LinearArena& arena) : arena(&arena) {}
+	template <typename U> FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(arena->Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void deallocate(T*, size_t) {}
+
+	template <typename U> bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U> bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+///////////////////////////////////////////////////
+// FrameArena
+///////////////////////////////////////////////////
+// two linear arenas used on alternate frames, BeginFrame is called at the top of Game::Update
+// data allocated during a frame stays valid through the following frame, so render data and
+// command buffers played back at the next Registry::Update can point into it
+///////////////////////////////////////////////////
+
+class FrameArena {
+private:
+	LinearArena arenas[2];
+	int currentArena = 0;
+
+public:
+	FrameArena(size_t capacity = 1024 * 1024);
+
+	// swaps arenas and resets the one becoming current
+	void BeginFrame();
+
+	LinearArena& GetCurrent();
+	const LinearArena& GetCurrent() const;
+	const LinearArena& GetPrevious() const;
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+		return GetCurrent().Allocate(size, alignment);
+	}
+
+	template <typename T> T* New(size_t count) {
+		return GetCurrent().New<T>(count);
+	}
+
+	template <typename T> FrameAllocator<T> GetAllocator() {
+		return FrameAllocator<T>(GetCurrent());
+	}
+
+	// most bytes used by a single frame since startup
+	size_t GetHighWaterMark() const;
+};
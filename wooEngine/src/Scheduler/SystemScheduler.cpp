@@ -0,0 +1,157 @@
+#include "SystemScheduler.h"
+#include "../Logger/Logger.h"
+
+static bool SystemsConflict(const System& a, const System& b) {
+	if (a.IsExclusive() || b.IsExclusive()) {
+		return true;
+	}
+
+	// a write conflicts with any other access to the same component
+	const Signature aAccess = a.GetReadSignature() | a.GetWriteSignature();
+	const Signature bAccess = b.GetReadSignature() | b.GetWriteSignature();
+	return (a.GetWriteSignature() & bAccess).any() || (b.GetWriteSignature() & aAccess).any();
+}
+
+void SystemScheduler::Schedule(const std::string& name, const System* system, Task update) {
+	const int index = numScheduledSystems++;
+	if (index == static_cast<int>(scheduledSystems.size())) {
+		scheduledSystems.push_back(std::make_unique<ScheduledSystem>());
+	}
+
+	ScheduledSystem& scheduledSystem = *scheduledSystems[index];
+	scheduledSystem.name = name;
+	scheduledSystem.system = system;
+	scheduledSystem.update = std::move(update);
+	scheduledSystem.dependencies.clear();
+	scheduledSystem.dependents.clear();
+	scheduledSystem.startMs = 0;
+	scheduledSystem.durationMs = 0;
+
+	// depend on every earlier system touching the same data
+	for (int i = 0; i < index; i++) {
+		if (SystemsConflict(*scheduledSystems[i]->system, *system)) {
+			scheduledSystem.dependencies.push_back(i);
+			scheduledSystems[i]->dependents.push_back(index);
+		}
+	}
+	scheduledSystem.numUnfinishedDependencies = static_cast<int>(scheduledSystem.dependencies.size());
+
+	if (index >= static_cast<int>(commandBuffers.size())) {
+		commandBuffers.push_back(&registry.CreateCommandBuffer());
+	}
+}
+
+void SystemScheduler::Dispatch(int index) {
+	if (scheduledSystems[index]->system->IsExclusive()) {
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		mainThreadSystems.push_back(index);
+	}
+	else {
+		threadPool.Submit([this, index]() { RunSystem(index); });
+	}
+}
+
+void SystemScheduler::RunSystem(int index) {
+	ScheduledSystem& scheduledSystem = *scheduledSystems[index];
+	const auto start = std::chrono::steady_clock::now();
+
+	// exclusive systems record into their slot too, so their changes apply after those of earlier slots
+	{
+		CommandBuffer::Scope scope(*commandBuffers[index]);
+		scheduledSystem.update();
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	scheduledSystem.startMs = std::chrono::duration<double, std::milli>(start - frameStart).count();
+	scheduledSystem.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+	for (int dependent : scheduledSystem.dependents) {
+		if (--scheduledSystems[dependent]->numUnfinishedDependencies == 0) {
+			Dispatch(dependent);
+		}
+	}
+	numFinishedSystems++;
+}
+
+void SystemScheduler::Run() {
+	frameStart = std::chrono::steady_clock::now();
+	numFinishedSystems = 0;
+
+	for (int i = 0; i < numScheduledSystems; i++) {
+		if (scheduledSystems[i]->dependencies.empty()) {
+			Dispatch(i);
+		}
+	}
+
+	// run exclusive systems here and help the pool with the rest
+	while (numFinishedSystems < numScheduledSystems) {
+		int index = -1;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			if (!mainThreadSystems.empty()) {
+				index = mainThreadSystems.back();
+				mainThreadSystems.pop_back();
+			}
+		}
+
+		if (index != -1) {
+			RunSystem(index);
+		}
+		else if (!threadPool.RunPendingTask()) {
+			std::this_thread::yield();
+		}
+	}
+
+	report.frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+	BuildReport();
+	numScheduledSystems = 0;
+}
+
+void SystemScheduler::BuildReport() {
+	const int numSystems = numScheduledSystems;
+
+	// longest path through the dependency graph, weighted by measured durations
+	// dependencies always precede their dependents in schedule order
+	pathMs.assign(numSystems, 0);
+	previous.assign(numSystems, -1);
+	int last = -1;
+
+	for (int i = 0; i < numSystems; i++) {
+		for (int dependency : scheduledSystems[i]->dependencies) {
+			if (pathMs[dependency] > pathMs[i]) {
+				pathMs[i] = pathMs[dependency];
+				previous[i] = dependency;
+			}
+		}
+		pathMs[i] += scheduledSystems[i]->durationMs;
+
+		if (last == -1 || pathMs[i] > pathMs[last]) {
+			last = i;
+		}
+	}
+
+	// entries are assigned in place so their name strings keep their memory
+	report.systems.resize(numSystems);
+	for (int i = 0; i < numSystems; i++) {
+		SystemTiming& timing = report.systems[i];
+		timing.name = scheduledSystems[i]->name;
+		timing.startMs = scheduledSystems[i]->startMs;
+		timing.durationMs = scheduledSystems[i]->durationMs;
+		timing.isOnCriticalPath = false;
+	}
+
+	report.criticalPathMs = last == -1 ? 0 : pathMs[last];
+	criticalPath.clear();
+	for (int i = last; i != -1; i = previous[i]) {
+		report.systems[i].isOnCriticalPath = true;
+		criticalPath.push_back(i);
+	}
+
+	report.criticalPath.clear();
+	for (auto i = criticalPath.rbegin(); i != criticalPath.rend(); i++) {
+		if (!report.criticalPath.empty()) {
+			report.criticalPath += " -> ";
+		}
+		report.criticalPath += scheduledSystems[*i]->name;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../ECS/ECS.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////
+// SystemScheduler
+///////////////////////////////////////////////////
+// runs one frame of system updates on a thread pool
+// systems are scheduled in order every frame, a system waits for every earlier
+// system whose declared component reads/writes conflict with its own
+// exclusive systems wait for everything before them and run on the calling thread
+// structural changes of every system go to one command buffer per schedule slot, played back in order
+///////////////////////////////////////////////////
+
+struct SystemTiming {
+	std::string name;
+	double startMs;
+	double durationMs;
+	bool isOnCriticalPath;
+};
+
+struct SchedulerReport {
+	std::vector<SystemTiming> systems;
+	double frameMs = 0;
+
+	// longest chain of dependent systems, the lower bound of the frame time
+	double criticalPathMs = 0;
+	std::string criticalPath;
+};
+
+class SystemScheduler {
+private:
+	struct ScheduledSystem {
+		std::string name;
+		const System* system;
+		Task update;
+		std::vector<int> dependencies;
+		std::vector<int> dependents;
+		std::atomic<int> numUnfinishedDependencies = 0;
+		double startMs = 0;
+		double durationMs = 0;
+	};
+
+	Registry& registry;
+	ThreadPool& threadPool;
+
+	// slots are kept across frames so scheduling does not allocate once the schedule is stable
+	std::vector<std::unique_ptr<ScheduledSystem>> scheduledSystems;
+	int numScheduledSystems = 0;
+
+	// command buffer of each schedule slot, kept across frames
+	std::vector<CommandBuffer*> commandBuffers;
+
+	// exclusive systems whose dependencies finished, run by the thread calling Run
+	std::mutex mainThreadMutex;
+	std::vector<int> mainThreadSystems;
+	std::atomic<int> numFinishedSystems = 0;
+
+	std::chrono::steady_clock::time_point frameStart;
+	SchedulerReport report;
+
+	// scratch space of BuildReport
+	std::vector<double> pathMs;
+	std::vector<int> previous;
+	std::vector<int> criticalPath;
+
+	void Schedule(const std::string& name, const System* system, Task update);
+	void Dispatch(int index);
+	void RunSystem(int index);
+	void BuildReport();
+
+public:
+	SystemScheduler(Registry& registry, ThreadPool& threadPool) : registry(registry), threadPool(threadPool) {};
+
+	// add the update of a system to the current frame
+	// ie: scheduler->Schedule<AnimationSystem>([&]() { registry->GetSystem<AnimationSystem>().Update(registry); });
+	template <typename TSystem> void Schedule(Task update);
+
+	// run every scheduled system and clear the schedule
+	void Run();
+
+	const SchedulerReport& GetLastReport() const {
+		return report;
+	}
+};
+
+template <typename TSystem>
+void SystemScheduler::Schedule(Task update) {
+	// msvc prefixes type names with their kind
+	static const std::string name = [] {
+		std::string name = typeid(TSystem).name();
+		const std::string prefix = "class ";
+		if (name.compare(0, prefix.size(), prefix) == 0) {
+			name.erase(0, prefix.size());
+		}
+		return name;
+	}();
+
+	Schedule(name, &registry.GetSystem<TSystem>(), std::move(update));
+}
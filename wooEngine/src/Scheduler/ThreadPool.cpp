@@ -0,0 +1,113 @@
+#include "ThreadPool.h"
+#include "../Logger/Logger.h"
+
+thread_local int ThreadPool::queueIndex = 0;
+
+ThreadPool::ThreadPool(int numThreads) {
+	numThreads = numThreads < 0 ? 0 : numThreads;
+
+	for (int i = 0; i <= numThreads; i++) {
+		queues.push_back(std::make_unique<TaskQueue>());
+	}
+	for (int i = 1; i <= numThreads; i++) {
+		workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+
+	Logger::Log("ThreadPool constructor called with " + std::to_string(numThreads) + " worker threads.");
+}
+
+ThreadPool::~ThreadPool() {
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		isRunning = false;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	Logger::Log("ThreadPool destructor called.");
+}
+
+int ThreadPool::GetNumThreads() const {
+	return static_cast<int>(workers.size());
+}
+
+void ThreadPool::Submit(Task task) {
+	numPendingTasks++;
+	{
+		std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+		queues[queueIndex]->tasks.push_back(std::move(task));
+	}
+
+	// counted under the sleep lock so a worker about to sleep cannot miss it
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		numQueuedTasks++;
+	}
+	wakeCondition.notify_one();
+}
+
+bool ThreadPool::PopTask(int index, Task& task, bool isOwner) {
+	TaskQueue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) {
+		return false;
+	}
+
+	// owners take the newest task while it is still hot in cache, thieves the oldest
+	if (isOwner) {
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+	}
+	else {
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+	}
+	numQueuedTasks--;
+	return true;
+}
+
+bool ThreadPool::RunPendingTask() {
+	Task task;
+	bool isFound = PopTask(queueIndex, task, true);
+
+	for (size_t offset = 1; !isFound && offset < queues.size(); offset++) {
+		isFound = PopTask(static_cast<int>((queueIndex + offset) % queues.size()), task, false);
+	}
+
+	if (!isFound) {
+		return false;
+	}
+
+	task();
+	numPendingTasks--;
+	return true;
+}
+
+void ThreadPool::Wait() {
+	while (numPendingTasks > 0) {
+		if (!RunPendingTask()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ThreadPool::WorkerLoop(int index) {
+	queueIndex = index;
+
+	while (true) {
+		if (RunPendingTask()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]() { return numQueuedTasks > 0 || !isRunning; });
+		if (!isRunning) {
+			return;
+		}
+	}
+}
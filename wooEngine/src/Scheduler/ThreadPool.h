@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////
+// ThreadPool
+///////////////////////////////////////////////////
+// fixed set of worker threads, each with its own task queue
+// workers pop their newest task first and steal the oldest task of
+// another queue when their own runs dry
+///////////////////////////////////////////////////
+
+typedef std::function<void()> Task;
+
+class ThreadPool {
+private:
+	struct TaskQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	// queue 0 belongs to the threads outside the pool (ie: main thread), queue i + 1 to worker i
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<int> numQueuedTasks = 0;
+	std::atomic<int> numPendingTasks = 0;
+	std::atomic<bool> isRunning = true;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+
+	// queue of the calling thread
+	static thread_local int queueIndex;
+
+	bool PopTask(int index, Task& task, bool isOwner);
+	void WorkerLoop(int index);
+
+public:
+	// numThreads = 0 runs every task on the threads calling Wait / RunPendingTask
+	ThreadPool(int numThreads);
+	~ThreadPool();
+
+	int GetNumThreads() const;
+
+	// queue a task on the calling thread's queue, safe to call from tasks
+	void Submit(Task task);
+
+	// run one queued task on the calling thread, returns false if none was found
+	bool RunPendingTask();
+
+	// block until every submitted task finished, running tasks meanwhile
+	void Wait();
+};
@@ -10,15 +10,17 @@ public:
 	AnimationSystem() {
 		RequireComponent<AnimationComponent>();
 		RequireComponent<SpriteComponent>();
+
+		Writes<AnimationComponent>();
+		Writes<SpriteComponent>();
 	}
 
-	void Update() {
-		for (auto entity : GetSystemEntities()) {
-			auto& animation = entity.GetComponent<AnimationComponent>();
-			auto& sprite = entity.GetComponent<SpriteComponent>();
-			
-			animation.currentFrame = ((SDL_GetTicks() - animation.startTime) * animation.frameSpeedRate / 1000) % animation.numFrames;
+	void Update(const std::unique_ptr<Registry>& registry) {
+		const auto ticks = SDL_GetTicks();
+
+		registry->View<AnimationComponent, SpriteComponent>().ParallelEach([ticks](Entity, AnimationComponent& animation, SpriteComponent& sprite) {
+			animation.currentFrame = ((ticks - animation.startTime) * animation.frameSpeedRate / 1000) % animation.numFrames;
 			sprite.srcRect.x = animation.currentFrame * sprite.width;	// use current frame to shift srcRect of spritesheet
-		}
+		});
 	}
 };
\ No newline at end of file
@@ -10,6 +10,9 @@ public:
 	CameraMovementSystem() {
 		RequireComponent<TransformComponent>();
 		RequireComponent<CameraFollowComponent>();
+
+		Reads<TransformComponent>();
+		Reads<CameraFollowComponent>();
 	}
 
 	void Update(SDL_Rect& camera) {
@@ -3,62 +3,412 @@
 #include "../ECS/ECS.h"
 #include "../Components/BoxColliderComponent.h"
 #include "../Components/TransformComponent.h"
+#include "../Components/StaticBodyComponent.h"
 #include "../EventBus/EventBus.h"
 #include "../Events/CollisionEvent.h"
+#include "../Collision/SpatialHashGrid.h"
+#include "../Collision/DynamicAABBTree.h"
+#include "../Collision/SweepAndPrune.h"
+#include "../Collision/CollisionLayers.h"
+#include <chrono>
+#include <string>
+
+// how candidate pairs of colliders are found
+enum Broadphase {
+	BROADPHASE_GRID,
+	BROADPHASE_TREE,
+	BROADPHASE_SWEEP
+};
+
+// counts of the last update, for the debug gui
+struct CollisionStats {
+	int numColliders = 0;
+	int numTests = 0;
+	int numCollisions = 0;
+	double milliseconds = 0;
+	// proxies moved out of their fat box and reinserted, tree broadphase only
+	int numTreeMoves = 0;
+	int treeHeight = 0;
+	int numStaticColliders = 0;
+	int numStaticRebuilds = 0;
+};
 
 class CollisionSystem : public System {
+private:
+	Broadphase broadphase = BROADPHASE_GRID;
+	SpatialHashGrid grid;
+	DynamicAABBTree tree;
+	SweepAndPrune sweepAndPrune;
+
+	// layers each layer collides with, every layer collides with every other one unless told otherwise
+	uint32_t layerMatrix[MAX_COLLISION_LAYERS];
+
+	// tree proxy of every entity id, -1 if it has none, and the frame it was last seen
+	std::vector<int> proxyOfEntity;
+	std::vector<int> proxyFrameOfEntity;
+	std::vector<int> entitiesWithProxy;
+	int frame = 0;
+
+	// kept across frames to avoid allocating
+	// boxes[i] belongs to boxEntities[i], both are kept until the next update for queries
+	std::vector<CollisionBox> boxes;
+	std::vector<Entity> boxEntities;
+	std::vector<int> boxKeys;
+	std::vector<CollisionFilter> filters;
+	std::vector<CollisionPair> pairs;
+
+	// colliders with a StaticBodyComponent are left out of the system and baked into their
+	// own tree, rebuilt only when one is added or removed, and only tested against moving colliders
+	DynamicAABBTree staticTree;
+	std::vector<CollisionBox> staticBoxes;
+	std::vector<CollisionFilter> staticFilters;
+	std::vector<Entity> staticEntities;
+	// index of the moving box, index of the static box
+	std::vector<CollisionPair> staticPairs;
+	bool areStaticsDirty = true;
+
+	CollisionStats stats;
+
+	static CollisionBox GetBox(const TransformComponent& transform, const BoxColliderComponent& collider) {
+		return {
+			transform.position.x + collider.offset.x,
+			transform.position.y + collider.offset.y,
+			static_cast<float>(collider.width),
+			static_cast<float>(collider.height)
+		};
+	}
+
+	void RebuildStatics() {
+		staticTree.Clear();
+		staticBoxes.clear();
+		staticFilters.clear();
+		staticEntities.clear();
+
+		// static masks leave out the layer matrix, it is applied to the moving side of each pair
+		Entity::registry->View<StaticBodyComponent, BoxColliderComponent, TransformComponent>().Each([this](Entity entity, StaticBodyComponent&, BoxColliderComponent& collider, TransformComponent& transform) {
+			// components removed this frame are still in storage until the next refresh, the signature already dropped them
+			if (!entity.HasComponent<StaticBodyComponent>() || !entity.HasComponent<BoxColliderComponent>() || !entity.HasComponent<TransformComponent>()) {
+				return;
+			}
+			staticBoxes.push_back(GetBox(transform, collider));
+			staticFilters.push_back({ 1u << collider.layer, collider.mask });
+			staticEntities.push_back(entity);
+		});
+		for (int i = 0; i < static_cast<int>(staticBoxes.size()); i++) {
+			staticTree.CreateProxy(staticBoxes[i], i, staticFilters[i].layerBit);
+		}
+
+		areStaticsDirty = false;
+		stats.numStaticColliders = static_cast<int>(staticBoxes.size());
+		stats.numStaticRebuilds++;
+	}
+
+	void FindStaticPairs() {
+		staticPairs.clear();
+		for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+			const CollisionBox& box = boxes[i];
+			staticTree.Query(box, filters[i].mask, [&](int proxy) {
+				const int other = staticTree.GetUserData(proxy);
+				if ((staticFilters[other].mask & filters[i].layerBit) != 0) {
+					stats.numTests++;
+					if (BoxesOverlap(box, staticBoxes[other])) {
+						staticPairs.push_back({ i, other });
+					}
+				}
+				return true;
+			});
+		}
+		std::sort(staticPairs.begin(), staticPairs.end());
+	}
+
+	// keeps one tree proxy per collider, with the box index of this frame as user data
+	void UpdateTree() {
+		frame++;
+		for (int i = 0; i < static_cast<int>(boxEntities.size()); i++) {
+			const int id = boxEntities[i].GetId();
+			if (id >= static_cast<int>(proxyOfEntity.size())) {
+				proxyOfEntity.resize(id + 1, -1);
+				proxyFrameOfEntity.resize(id + 1, 0);
+			}
+
+			int& proxy = proxyOfEntity[id];
+			if (proxy == -1) {
+				proxy = tree.CreateProxy(boxes[i], i, filters[i].layerBit);
+				entitiesWithProxy.push_back(id);
+			} else {
+				// a recycled entity id keeps the proxy of the killed entity, it is only a box
+				if (tree.MoveProxy(proxy, boxes[i])) {
+					stats.numTreeMoves++;
+				}
+				tree.SetUserData(proxy, i);
+				if (tree.GetLayerBits(proxy) != filters[i].layerBit) {
+					tree.SetLayerBits(proxy, filters[i].layerBit);
+				}
+			}
+			proxyFrameOfEntity[id] = frame;
+		}
+
+		// colliders not seen this frame were killed or lost a component
+		for (int i = 0; i < static_cast<int>(entitiesWithProxy.size());) {
+			const int id = entitiesWithProxy[i];
+			if (proxyFrameOfEntity[id] == frame) {
+				i++;
+				continue;
+			}
+			tree.DestroyProxy(proxyOfEntity[id]);
+			proxyOfEntity[id] = -1;
+			entitiesWithProxy[i] = entitiesWithProxy.back();
+			entitiesWithProxy.pop_back();
+		}
+		stats.treeHeight = tree.GetHeight();
+	}
+
+	void FindTreePairs() {
+		stats.numTests = 0;
+		for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+			const CollisionBox& box = boxes[i];
+			// branches without a layer the box collides with are skipped
+			tree.Query(box, filters[i].mask, [&](int proxy) {
+				// each pair is found from both of its boxes, the lower index reports it
+				const int other = tree.GetUserData(proxy);
+				if (other > i && (filters[other].mask & filters[i].layerBit) != 0) {
+					stats.numTests++;
+					if (BoxesOverlap(box, boxes[other])) {
+						pairs.push_back({ i, other });
+					}
+				}
+				return true;
+			});
+		}
+		std::sort(pairs.begin(), pairs.end());
+	}
+
+	void ClearTree() {
+		tree.Clear();
+		proxyOfEntity.clear();
+		proxyFrameOfEntity.clear();
+		entitiesWithProxy.clear();
+	}
+
 public:
 	CollisionSystem() {
 		RequireComponent<BoxColliderComponent>();
 		RequireComponent<TransformComponent>();
+		ExcludeComponent<StaticBodyComponent>();
+
+		// static boxes never move, so they need no margin
+		staticTree.SetMargin(0);
+
+		for (auto& layers : layerMatrix) {
+			layers = COLLISION_MASK_ALL;
+		}
+
+		// collision events are handled synchronously by other systems' subscribers
+		SetExclusive();
 	}
 
-	bool CheckAABBCollision(double aX, double aY, double aW, double aH, double bX, double bY, double bW, double bH) {
-		return (
-			aX < bX + bW &&
-			aX + aW > bX &&
-			aY < bY + bH &&
-			aY + aH > bY
-			);
+	// any change to a static collider rebuilds the static tree in the next update
+	void SubscribeToChanges(const std::unique_ptr<Registry>& registry) {
+		const auto invalidateStatic = [this](Entity entity) {
+			if (entity.HasComponent<StaticBodyComponent>()) {
+				areStaticsDirty = true;
+			}
+		};
+		registry->OnConstruct<StaticBodyComponent>([this](Entity) { areStaticsDirty = true; });
+		registry->OnDestroy<StaticBodyComponent>([this](Entity) { areStaticsDirty = true; });
+		registry->OnConstruct<BoxColliderComponent>(invalidateStatic);
+		registry->OnDestroy<BoxColliderComponent>(invalidateStatic);
+		registry->OnConstruct<TransformComponent>(invalidateStatic);
+		registry->OnDestroy<TransformComponent>(invalidateStatic);
 	}
 
-	void Update(std::unique_ptr<EventBus>& eventBus) {
-		auto entities = GetSystemEntities();
+	// forces a rebuild, ie: after loading a snapshot or moving a static collider, which do not notify observers
+	void InvalidateStatics() {
+		areStaticsDirty = true;
+	}
 
-		// Loop relevant entities
-		for (auto i = entities.begin(); i != entities.end(); i++) {
-			Entity a = *i;
-			auto aTransform = a.GetComponent<TransformComponent>();
-			auto aCollider = a.GetComponent<BoxColliderComponent>();
+	// size of the broadphase grid cells, ie: a little larger than most colliders
+	void SetCellSize(double cellSize) {
+		grid.SetCellSize(cellSize);
+	}
+
+	// whether colliders on the two layers collide, ie: SetLayersInteract(enemiesLayer, enemiesLayer, false)
+	void SetLayersInteract(int layerA, int layerB, bool interact) {
+		if (interact) {
+			layerMatrix[layerA] |= 1u << layerB;
+			layerMatrix[layerB] |= 1u << layerA;
+		} else {
+			layerMatrix[layerA] &= ~(1u << layerB);
+			layerMatrix[layerB] &= ~(1u << layerA);
+		}
+	}
+
+	bool DoLayersInteract(int layerA, int layerB) const {
+		return (layerMatrix[layerA] & (1u << layerB)) != 0;
+	}
+
+	// distance tree proxies are grown by, larger margins reinsert fast colliders less often
+	void SetTreeMargin(float margin) {
+		tree.SetMargin(margin);
+		ClearTree();
+	}
+
+	void SetBroadphase(Broadphase broadphase) {
+		if (broadphase == this->broadphase) {
+			return;
+		}
+		this->broadphase = broadphase;
+		ClearTree();
+		sweepAndPrune.Clear();
+	}
 
-			// Loop remainder of list (right of i)
-			for (auto j = i; j != entities.end(); j++) {
-				Entity b = *j;
+	Broadphase GetBroadphase() const {
+		return broadphase;
+	}
+
+	// ie: "grid", "tree" or "sweep", as written in level files
+	void SetBroadphase(const std::string& name) {
+		if (name == "grid") {
+			SetBroadphase(BROADPHASE_GRID);
+		} else if (name == "tree") {
+			SetBroadphase(BROADPHASE_TREE);
+		} else if (name == "sweep") {
+			SetBroadphase(BROADPHASE_SWEEP);
+		} else {
+			Logger::Err("Unknown collision broadphase " + name + ", keeping the current one.");
+		}
+	}
 
-				if (a == b) {
-					continue;
+	// entities on a layer of the mask whose collider overlapped the box at the last update
+	void QueryBox(const CollisionBox& box, std::vector<Entity>& result, uint32_t mask = COLLISION_MASK_ALL) const {
+		if (broadphase == BROADPHASE_TREE) {
+			tree.Query(box, mask, [&](int proxy) {
+				const int i = tree.GetUserData(proxy);
+				if (BoxesOverlap(box, boxes[i])) {
+					result.push_back(boxEntities[i]);
+				}
+				return true;
+			});
+		} else {
+			for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+				if ((filters[i].layerBit & mask) != 0 && BoxesOverlap(box, boxes[i])) {
+					result.push_back(boxEntities[i]);
 				}
+			}
+		}
 
-				auto bTransform = b.GetComponent<TransformComponent>();
-				auto bCollider = b.GetComponent<BoxColliderComponent>();
-
-				bool collisionAB = CheckAABBCollision(
-					aTransform.position.x + aCollider.offset.x,
-					aTransform.position.y + aCollider.offset.y,
-					aCollider.width,
-					aCollider.height,
-					bTransform.position.x + bCollider.offset.x,
-					bTransform.position.y + bCollider.offset.y,
-					bCollider.width,
-					bCollider.height
-				);
-
-				if (collisionAB) {
-					//Logger::Log("Entity " + std::to_string(a.GetId()) + " is colliding with entity " + std::to_string(b.GetId()));
-					
-					eventBus->EmitEvent<CollisionEvent>(a, b);
+		staticTree.Query(box, mask, [&](int proxy) {
+			const int i = staticTree.GetUserData(proxy);
+			if (BoxesOverlap(box, staticBoxes[i])) {
+				result.push_back(staticEntities[i]);
+			}
+			return true;
+		});
+	}
+
+	// first entity on a layer of the mask whose collider the segment from -> to crossed at the last update
+	bool RayCast(const glm::vec2& from, const glm::vec2& to, Entity& hit, double& fraction, uint32_t mask = COLLISION_MASK_ALL) const {
+		const glm::dvec2 start(from);
+		const glm::dvec2 end(to);
+		int hitBox = -1;
+		if (broadphase == BROADPHASE_TREE) {
+			tree.RayCast(start, end, [&](int proxy, double maxFraction) {
+				const int i = tree.GetUserData(proxy);
+				double boxFraction;
+				if ((filters[i].layerBit & mask) != 0 && SegmentHitsBox(start, end, boxes[i], boxFraction) && boxFraction < maxFraction) {
+					hitBox = i;
+					fraction = boxFraction;
+					return boxFraction;
+				}
+				return maxFraction;
+			});
+		} else {
+			fraction = 1;
+			for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+				double boxFraction;
+				if ((filters[i].layerBit & mask) != 0 && SegmentHitsBox(start, end, boxes[i], boxFraction) && (hitBox == -1 || boxFraction < fraction)) {
+					hitBox = i;
+					fraction = boxFraction;
 				}
 			}
 		}
+
+		int hitStaticBox = -1;
+		staticTree.RayCast(start, end, [&](int proxy, double maxFraction) {
+			const int i = staticTree.GetUserData(proxy);
+			double boxFraction;
+			if ((staticFilters[i].layerBit & mask) != 0 && SegmentHitsBox(start, end, staticBoxes[i], boxFraction) && boxFraction < maxFraction &&
+				(hitBox == -1 || boxFraction < fraction)) {
+				hitStaticBox = i;
+				fraction = boxFraction;
+				return boxFraction;
+			}
+			return maxFraction;
+		});
+
+		if (hitStaticBox != -1) {
+			hit = staticEntities[hitStaticBox];
+			return true;
+		}
+		if (hitBox != -1) {
+			hit = boxEntities[hitBox];
+			return true;
+		}
+		return false;
+	}
+
+	const CollisionStats& GetStats() const {
+		return stats;
+	}
+
+	void Update(std::unique_ptr<EventBus>& eventBus) {
+		const auto start = std::chrono::steady_clock::now();
+		const auto& entities = GetSystemEntities();
+
+		if (areStaticsDirty) {
+			RebuildStatics();
+		}
+
+		// world space boxes of the moving colliders, boxes[i] belongs to entities[i]
+		boxes.clear();
+		boxEntities.assign(entities.begin(), entities.end());
+		boxKeys.clear();
+		filters.clear();
+		for (auto entity : entities) {
+			boxKeys.push_back(entity.GetId());
+			const auto& collider = entity.GetComponent<BoxColliderComponent>();
+			boxes.push_back(GetBox(entity.GetComponent<TransformComponent>(), collider));
+			filters.push_back({ 1u << collider.layer, collider.mask & layerMatrix[collider.layer] });
+		}
+
+		// only boxes sharing a grid cell, a tree branch or an x range are tested, pairs come in the order of the entity list
+		pairs.clear();
+		stats.numTreeMoves = 0;
+		stats.treeHeight = 0;
+		if (broadphase == BROADPHASE_TREE) {
+			UpdateTree();
+			FindTreePairs();
+		} else if (broadphase == BROADPHASE_SWEEP) {
+			sweepAndPrune.FindOverlappingPairs(boxes, filters, boxKeys, pairs);
+			stats.numTests = sweepAndPrune.GetNumTests();
+		} else {
+			grid.FindOverlappingPairs(boxes, filters, pairs);
+			stats.numTests = grid.GetNumTests();
+		}
+
+		// static colliders are never tested against each other
+		FindStaticPairs();
+
+		// timed without the event handlers
+		stats.numColliders = static_cast<int>(entities.size());
+		stats.numCollisions = static_cast<int>(pairs.size() + staticPairs.size());
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		for (const auto& pair : pairs) {
+			eventBus->EmitEvent<CollisionEvent>(entities[pair.first], entities[pair.second]);
+		}
+		for (const auto& pair : staticPairs) {
+			eventBus->EmitEvent<CollisionEvent>(entities[pair.first], staticEntities[pair.second]);
+		}
 	}
 };
\ No newline at end of file
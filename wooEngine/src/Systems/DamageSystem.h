@@ -9,6 +9,11 @@
 
 
 class DamageSystem : public System {
+private:
+	const int playerTag = Registry::InternTag("player");
+	const int projectilesGroup = Registry::InternGroup("projectiles");
+	const int enemiesGroup = Registry::InternGroup("enemies");
+
 public:
 	DamageSystem() {
 		RequireComponent<BoxColliderComponent>();
@@ -23,17 +28,17 @@ public:
 		Entity b = event.b;
 		//Logger::Log("Damage system received event collision between entities " + std::to_string(a.GetId()) + " and " + std::to_string(b.GetId()));
 		
-		if (a.BelongsToGroup("projectiles") && b.HasTag("player")) {
+		if (a.BelongsToGroup(projectilesGroup) && b.HasTag(playerTag)) {
 			onProjectilePlayerCollision(a, b);
 		}
-		if (b.BelongsToGroup("projectiles") && a.HasTag("player")) {
+		if (b.BelongsToGroup(projectilesGroup) && a.HasTag(playerTag)) {
 			onProjectilePlayerCollision(b, a);
 		}
 
-		if (a.BelongsToGroup("projectiles") && b.BelongsToGroup("enemies")) {
+		if (a.BelongsToGroup(projectilesGroup) && b.BelongsToGroup(enemiesGroup)) {
 			onProjectileEnemyCollision(a, b);
 		}
-		if (b.BelongsToGroup("projectiles") && a.BelongsToGroup("enemies")) {
+		if (b.BelongsToGroup(projectilesGroup) && a.BelongsToGroup(enemiesGroup)) {
 			onProjectileEnemyCollision(b, a);
 		}
 	}
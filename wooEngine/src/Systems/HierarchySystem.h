@@ -0,0 +1,228 @@
+#pragma once
+
+#include "../ECS/ECS.h"
+#include "../Components/TransformComponent.h"
+#include "../Components/ParentComponent.h"
+#include "../Components/ChildrenComponent.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+///////////////////////////////////////////////////
+// HierarchySystem
+///////////////////////////////////////////////////
+// computes the world transform of every child entity from its parent's
+// nodes are stored contiguously in depth-first order, so parents are always
+// computed before their children and every subtree is one range of the array
+// only subtrees whose root moved or whose local transform was patched are recomputed
+// the order is rebuilt when a ParentComponent or ChildrenComponent is added or removed,
+// or when an entity of the hierarchy loses its TransformComponent
+///////////////////////////////////////////////////
+
+class HierarchySystem : public System {
+private:
+	struct Node {
+		Entity entity;
+		// index of the parent node, -1 for roots
+		int parent;
+		// one past the last node of the subtree rooted here
+		int subtreeEnd;
+		// world transform computed or seen last time
+		TransformComponent world;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> rootNodes;
+
+	// node of each entity, -1 outside the hierarchy
+	// vector index = entity id
+	std::vector<int> nodeOfEntity;
+
+	// nodes whose local transform was patched since the last update
+	std::vector<int> dirtyNodes;
+	bool isOrderDirty = true;
+
+	static bool TransformChanged(const TransformComponent& a, const TransformComponent& b) {
+		return a.position != b.position || a.scale != b.scale || a.rotation != b.rotation;
+	}
+
+	static TransformComponent Combine(const TransformComponent& parent, const ParentComponent& local) {
+		const double angle = glm::radians(parent.rotation);
+		const glm::vec2 offset = local.localPosition * parent.scale;
+		const glm::vec2 rotatedOffset(
+			offset.x * cos(angle) - offset.y * sin(angle),
+			offset.x * sin(angle) + offset.y * cos(angle)
+		);
+		return TransformComponent(parent.position + rotatedOffset, parent.scale * local.localScale, parent.rotation + local.localRotation);
+	}
+
+	int FindNode(Entity entity) const {
+		const int entityId = entity.GetId();
+		if (entityId >= static_cast<int>(nodeOfEntity.size()) || nodeOfEntity[entityId] == -1) {
+			return -1;
+		}
+		const int node = nodeOfEntity[entityId];
+		return nodes[node].entity == entity ? node : -1;
+	}
+
+	void RebuildOrder() {
+		nodes.clear();
+		rootNodes.clear();
+		dirtyNodes.clear();
+		std::fill(nodeOfEntity.begin(), nodeOfEntity.end(), -1);
+
+		Entity::registry->View<ChildrenComponent>().Each([](Entity, ChildrenComponent& children) {
+			children.children.clear();
+		});
+
+		// children of a killed parent are killed with it, system entities that lost a component
+		// this frame are still listed until the next registry update
+		std::vector<Entity> roots;
+		int numChildren = 0;
+		for (auto child : GetSystemEntities()) {
+			if (!child.HasComponent<TransformComponent>() || !child.HasComponent<ParentComponent>()) {
+				continue;
+			}
+
+			Entity parent = child.GetComponent<ParentComponent>().parent;
+			if (!parent.IsAlive() || !parent.HasComponent<TransformComponent>()) {
+				child.Kill();
+				continue;
+			}
+
+			// only this system reads children lists, so the component is added directly to fill it now
+			if (!parent.HasComponent<ChildrenComponent>()) {
+				CommandBuffer::DirectScope direct;
+				parent.AddComponent<ChildrenComponent>();
+			}
+			parent.GetComponent<ChildrenComponent>().children.push_back(child);
+			numChildren++;
+
+			if (!parent.HasComponent<ParentComponent>()) {
+				roots.push_back(parent);
+			}
+		}
+
+		std::sort(roots.begin(), roots.end(), [](Entity a, Entity b) { return a.GetId() < b.GetId(); });
+		roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+
+		// depth-first, children are pushed in reverse so they are visited in list order
+		std::vector<std::pair<Entity, int>> stack;
+		for (auto root : roots) {
+			rootNodes.push_back(static_cast<int>(nodes.size()));
+			stack.push_back({ root, -1 });
+			while (!stack.empty()) {
+				const auto [entity, parent] = stack.back();
+				stack.pop_back();
+
+				const int node = static_cast<int>(nodes.size());
+				nodes.push_back({ entity, parent, node + 1, TransformComponent() });
+				if (entity.GetId() >= static_cast<int>(nodeOfEntity.size())) {
+					nodeOfEntity.resize(entity.GetId() + 1, -1);
+				}
+				nodeOfEntity[entity.GetId()] = node;
+
+				if (entity.HasComponent<ChildrenComponent>()) {
+					const auto& children = entity.GetComponent<ChildrenComponent>().children;
+					for (auto child = children.rbegin(); child != children.rend(); ++child) {
+						stack.push_back({ *child, node });
+					}
+				}
+			}
+		}
+
+		// a subtree ends where the last subtree of its children ends, children come after their parent
+		for (int node = static_cast<int>(nodes.size()) - 1; node >= 0; node--) {
+			const int parent = nodes[node].parent;
+			if (parent != -1) {
+				nodes[parent].subtreeEnd = std::max(nodes[parent].subtreeEnd, nodes[node].subtreeEnd);
+			}
+		}
+
+		// children never reached from a root are part of a cycle
+		if (static_cast<int>(nodes.size() - roots.size()) < numChildren) {
+			Logger::Warn("Parent cycle found, " + std::to_string(numChildren - (nodes.size() - roots.size())) + " entities are not updated.");
+		}
+		isOrderDirty = false;
+	}
+
+	// recomputes the world transforms below first, whose own world transform must be up to date
+	// unless it is a child, which is recomputed from its parent as well
+	void UpdateSubtree(int first) {
+		for (int node = first; node < nodes[first].subtreeEnd; node++) {
+			if (nodes[node].parent == -1) {
+				continue;
+			}
+
+			const Entity entity = nodes[node].entity;
+			nodes[node].world = Combine(nodes[nodes[node].parent].world, entity.GetComponent<ParentComponent>());
+			entity.GetComponent<TransformComponent>() = nodes[node].world;
+			Entity::registry->MarkPatched<TransformComponent>(entity);
+		}
+	}
+
+public:
+	HierarchySystem() {
+		RequireComponent<TransformComponent>();
+		RequireComponent<ParentComponent>();
+
+		// children components are added while rebuilding, which needs direct structural changes
+		SetExclusive();
+	}
+
+	void SubscribeToChanges(const std::unique_ptr<Registry>& registry) {
+		registry->OnConstruct<ParentComponent>([this](Entity) { isOrderDirty = true; });
+		registry->OnDestroy<ParentComponent>([this](Entity) { isOrderDirty = true; });
+		registry->OnDestroy<ChildrenComponent>([this](Entity) { isOrderDirty = true; });
+
+		// nodes are read without checking for a transform, so losing one rebuilds the order first
+		registry->OnDestroy<TransformComponent>([this](Entity entity) {
+			if (FindNode(entity) != -1) {
+				isOrderDirty = true;
+			}
+		});
+
+		// patching a local transform, ie: from set_local_position, recomputes that subtree only
+		registry->OnUpdate<ParentComponent>([this](Entity entity) {
+			const int node = FindNode(entity);
+			if (node != -1) {
+				dirtyNodes.push_back(node);
+			}
+		});
+	}
+
+	// forces a rebuild, ie: after loading a snapshot, which does not notify observers
+	void Invalidate() {
+		isOrderDirty = true;
+	}
+
+	void Update() {
+		if (isOrderDirty) {
+			RebuildOrder();
+			for (int root : rootNodes) {
+				nodes[root].world = nodes[root].entity.GetComponent<TransformComponent>();
+				UpdateSubtree(root);
+			}
+			return;
+		}
+
+		// roots are compared with the transform seen last time, children of unmoved roots are not visited
+		for (int root : rootNodes) {
+			const TransformComponent& transform = nodes[root].entity.GetComponent<TransformComponent>();
+			if (TransformChanged(transform, nodes[root].world)) {
+				nodes[root].world = transform;
+				dirtyNodes.push_back(root);
+			}
+		}
+
+		// a dirty node inside a subtree already recomputed is skipped
+		std::sort(dirtyNodes.begin(), dirtyNodes.end());
+		int recomputedEnd = 0;
+		for (int node : dirtyNodes) {
+			if (node >= recomputedEnd) {
+				UpdateSubtree(node);
+				recomputedEnd = nodes[node].subtreeEnd;
+			}
+		}
+		dirtyNodes.clear();
+	}
+};
@@ -8,10 +8,18 @@
 #include "../Events/CollisionEvent.h"
 
 class MovementSystem : public System {
+private:
+	const int playerTag = Registry::InternTag("player");
+	const int enemiesGroup = Registry::InternGroup("enemies");
+	const int obstaclesGroup = Registry::InternGroup("obstacles");
+
 public:
 	MovementSystem() {
 		 RequireComponent<TransformComponent>();
 		 RequireComponent<RigidBodyComponent>();
+
+		 Writes<TransformComponent>();
+		 Reads<RigidBodyComponent>();
 	}
 
 	void SubscribeToEvents(std::unique_ptr<EventBus>& eventBus) {
@@ -23,10 +31,10 @@ public:
 		Entity b = event.b;
 		//Logger::Log("Movement system received event collision between entities " + std::to_string(a.GetId()) + " and " + std::to_string(b.GetId()));
 
-		if (a.BelongsToGroup("enemies") && b.BelongsToGroup("obstacles")) {
+		if (a.BelongsToGroup(enemiesGroup) && b.BelongsToGroup(obstaclesGroup)) {
 			onEnemyObstacleCollision(a, b);
 		}
-		if (b.BelongsToGroup("enemies") && a.BelongsToGroup("obstacles")) {
+		if (b.BelongsToGroup(enemiesGroup) && a.BelongsToGroup(obstaclesGroup)) {
 			onEnemyObstacleCollision(b, a);
 		}
 	}
@@ -35,7 +43,7 @@ public:
 		if (enemy.HasComponent<RigidBodyComponent>() && enemy.HasComponent<SpriteComponent>()) {
 			auto& rigidbody = enemy.GetComponent<RigidBodyComponent>();
 			auto& sprite = enemy.GetComponent<SpriteComponent>();
-			Logger::Log("Movement system received event collision between entities " + std::to_string(enemy.GetId()) + " and " + std::to_string(obstacle.GetId()));
+			WOO_LOG_DEBUG("Movement system received event collision between entities " + std::to_string(enemy.GetId()) + " and " + std::to_string(obstacle.GetId()));
 
 			if (rigidbody.velocity.x != 0) {
 				rigidbody.velocity.x *= -1;
@@ -49,16 +57,15 @@ public:
 		}
 	}
 
-	void Update(double deltaTime) {
-		for (auto entity : GetSystemEntities()) {
-			//update position based on velocity
-			auto& transform = entity.GetComponent<TransformComponent>();
-			auto& rigidbody = entity.GetComponent<RigidBodyComponent>();
+	void Update(const std::unique_ptr<Registry>& registry, double deltaTime) {
+		registry->Group<TransformComponent, RigidBodyComponent>().ParallelEach([this, &registry, deltaTime](Entity entity, TransformComponent& transform, RigidBodyComponent& rigidbody) {
+			const glm::vec2 previousPosition = transform.position;
 
+			//update position based on velocity
 			transform.position.x += rigidbody.velocity.x*deltaTime;
 			transform.position.y += rigidbody.velocity.y*deltaTime;
 
-			if (entity.HasTag("player")) {
+			if (entity.HasTag(playerTag)) {
 				int paddingTop = 8;
 				int paddingRight = 8;
 				int paddingDown = 8;
@@ -69,6 +76,11 @@ public:
 				transform.position.y = transform.position.y > Game::mapWidth - paddingRight ? Game::mapWidth - paddingRight : transform.position.y;
 			}
 
+			// only moved entities end up in the changed list of transforms
+			if (transform.position != previousPosition) {
+				registry->MarkPatched<TransformComponent>(entity);
+			}
+
 			bool isEntityOutsideMap = (
 				transform.position.x < 0 ||
 				transform.position.x > Game::mapWidth ||
@@ -76,9 +88,9 @@ public:
 				transform.position.y > Game::mapHeight
 			);
 
-			if (isEntityOutsideMap && !entity.HasTag("player")) {
+			if (isEntityOutsideMap && !entity.HasTag(playerTag)) {
 				entity.Kill();
 			}
-		}
+		});
 	}
 };
\ No newline at end of file
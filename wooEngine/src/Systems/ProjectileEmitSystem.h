@@ -9,12 +9,54 @@
 #include "../Components/RigidBodyComponent.h"
 #include "../Components/SpriteComponent.h"
 #include "../Components/BoxColliderComponent.h"
+#include "../Collision/CollisionLayers.h"
+#include "../Memory/FrameArena.h"
 
 class ProjectileEmitSystem : public System {
+private:
+	const int playerTag = Registry::InternTag("player");
+	const int projectilesGroup = Registry::InternGroup("projectiles");
+	const int projectilesLayer = CollisionLayers::Intern("projectiles");
+
+	// position, velocity and projectile stats are set per instance
+	Prefab projectilePrefab;
+
+	// a projectile waiting to be instantiated
+	struct Emission {
+		glm::vec2 position;
+		glm::vec2 velocity;
+		ProjectileComponent projectile;
+	};
+
+	static void InitProjectile(Entity projectile, const Emission& emission) {
+		projectile.GetComponent<TransformComponent>().position = emission.position;
+		projectile.GetComponent<RigidBodyComponent>().velocity = emission.velocity;
+		projectile.GetComponent<ProjectileComponent>() = emission.projectile;
+	}
+
+	// emissions live in the frame arena, which outlives a deferred init function by a frame
+	void EmitProjectiles(Registry& registry, const Emission* emissions, int count) {
+		registry.Instantiate(projectilePrefab, count, [emissions](Entity projectile, int index) {
+			InitProjectile(projectile, emissions[index]);
+		});
+	}
+
 public:
 	ProjectileEmitSystem() {
 		RequireComponent<ProjectileEmitterComponent>();
 		RequireComponent<TransformComponent>();
+
+		Writes<ProjectileEmitterComponent>();
+		Reads<TransformComponent>();
+		Reads<SpriteComponent>();
+
+		projectilePrefab
+			.Add<TransformComponent>(glm::vec2(0.0, 0.0), glm::vec2(1.0, 1.0))
+			.Add<RigidBodyComponent>()
+			.Add<SpriteComponent>("bullet-texture", 4, 4, 4)
+			.Add<BoxColliderComponent>(4, 4, glm::vec2(0), projectilesLayer)
+			.Add<ProjectileComponent>()
+			.Group(projectilesGroup);
 	}
 
 	void SubscribeToEvents(std::unique_ptr<EventBus>& eventBus) {
@@ -24,7 +66,7 @@ public:
 	void onKeyPressed(KeyPressedEvent& event) {
 		for (auto entity : GetSystemEntities()) {
 			//only process input of player
-			if (entity.HasTag("player")) {
+			if (entity.HasTag(playerTag)) {
 				switch (event.symbol) {
 				case SDLK_SPACE:
 					auto& projectileEmitter = entity.GetComponent<ProjectileEmitterComponent>();
@@ -52,13 +94,10 @@ public:
 					projectileVelocity.y = projectileEmitter.projectileVelocity.y * directionY;
 
 
-					Entity projectile = entity.registry->CreateEntity();
-					projectile.Group("projectiles");
-					projectile.AddComponent<TransformComponent>(projectilePosition, glm::vec2(1.0, 1.0));
-					projectile.AddComponent<RigidBodyComponent>(projectileVelocity);
-					projectile.AddComponent<SpriteComponent>("bullet-texture", 4, 4, 4);
-					projectile.AddComponent<BoxColliderComponent>(4, 4);
-					projectile.AddComponent<ProjectileComponent>(projectileEmitter.isFriendly, projectileEmitter.hitDamage, projectileEmitter.projectileDuration);
+					const Emission emission = { projectilePosition, projectileVelocity, ProjectileComponent(projectileEmitter.isFriendly, projectileEmitter.hitDamage, projectileEmitter.projectileDuration) };
+					entity.registry->Instantiate(projectilePrefab, 1, [emission](Entity projectile, int) {
+						InitProjectile(projectile, emission);
+					});
 
 					break;
 				}
@@ -66,8 +105,14 @@ public:
 		}
 	}
 
-	void Update(std::unique_ptr<Registry>& registry) {
-		for (auto entity : GetSystemEntities()) {
+	void Update(std::unique_ptr<Registry>& registry, FrameArena& frameArena) {
+		// projectiles of every emitter are instantiated together
+		// every emitter fires at most once per update
+		const auto& entities = GetSystemEntities();
+		Emission* emissions = frameArena.New<Emission>(entities.size());
+		int numEmissions = 0;
+
+		for (auto entity : entities) {
 			auto& projectileEmitter = entity.GetComponent<ProjectileEmitterComponent>();
 			auto transform = entity.GetComponent<TransformComponent>();
 
@@ -84,17 +129,15 @@ public:
 					projectilePosition.y += (transform.scale.y * sprite.height / 2);
 				}
 
-				Entity projectile = registry->CreateEntity();
-				projectile.Group("projectiles");
-				projectile.AddComponent<TransformComponent>(projectilePosition, glm::vec2(1.0, 1.0));
-				projectile.AddComponent<RigidBodyComponent>(projectileEmitter.projectileVelocity);
-				projectile.AddComponent<SpriteComponent>("bullet-texture", 4, 4, 4);
-				projectile.AddComponent<BoxColliderComponent>(4, 4);
-				projectile.AddComponent<ProjectileComponent>(projectileEmitter.isFriendly, projectileEmitter.hitDamage, projectileEmitter.projectileDuration);
+				emissions[numEmissions++] = { projectilePosition, projectileEmitter.projectileVelocity, ProjectileComponent(projectileEmitter.isFriendly, projectileEmitter.hitDamage, projectileEmitter.projectileDuration) };
 
 				// update last emission time
 				projectileEmitter.lastEmissionTime = SDL_GetTicks();
 			}
 		}
+
+		if (numEmissions > 0) {
+			EmitProjectiles(*registry, emissions, numEmissions);
+		}
 	}
 };
\ No newline at end of file
@@ -8,6 +8,8 @@ class ProjectileLifecycleSystem : public System {
 public:
 	ProjectileLifecycleSystem() {
 		RequireComponent<ProjectileComponent>();
+
+		Reads<ProjectileComponent>();
 	}
 
 	void Update() {
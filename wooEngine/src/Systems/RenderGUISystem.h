@@ -7,6 +7,9 @@
 #include "../Components/BoxColliderComponent.h"
 #include "../Components/ProjectileEmitterComponent.h"
 #include "../Components/HealthComponent.h"
+#include "../Scheduler/SystemScheduler.h"
+#include "../Systems/CollisionSystem.h"
+#include "../Memory/FrameArena.h"
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_sdlrenderer.h>
 #include <imgui/imgui_impl_sdl.h>
@@ -15,7 +18,7 @@ class RenderGUISystem : public System {
 public:
 	RenderGUISystem() = default;
 
-	void Update(SDL_Renderer* renderer, const std::unique_ptr<Registry>& registry, SDL_Rect& camera) {
+	void Update(SDL_Renderer* renderer, const std::unique_ptr<Registry>& registry, SDL_Rect& camera, const SchedulerReport& schedulerReport, const FrameArena& frameArena) {
 		// refresh frame
 		ImGui_ImplSDLRenderer_NewFrame();
 		ImGui_ImplSDL2_NewFrame();
@@ -79,7 +82,7 @@ public:
 				enemy.AddComponent<TransformComponent>(glm::vec2(posX, posY), glm::vec2(scaleX, scaleY), glm::degrees(rotation));
 				enemy.AddComponent<RigidBodyComponent>(glm::vec2(velX, velY));
 				enemy.AddComponent<SpriteComponent>(sprites[spriteIndex], 32, 32, 1);
-				enemy.AddComponent<BoxColliderComponent>(25, 20, glm::vec2(5, 5));
+				enemy.AddComponent<BoxColliderComponent>(25, 20, glm::vec2(5, 5), CollisionLayers::Intern("enemies"));
 
 				double projVelX = cos(projAngle) * projSpeed;
 				double projVelY = sin(projAngle) * projSpeed;
@@ -110,6 +113,133 @@ public:
 		}
 		ImGui::End();
 
+		if (ImGui::Begin("Systems")) {
+			ImGui::Text("Frame %.3f ms, critical path %.3f ms", schedulerReport.frameMs, schedulerReport.criticalPathMs);
+			ImGui::TextWrapped("%s", schedulerReport.criticalPath.c_str());
+			ImGui::Text(
+				"Frame arena %.1f / %.1f KB, high-water mark %.1f KB",
+				frameArena.GetPrevious().GetUsed() / 1024.0,
+				frameArena.GetPrevious().GetCapacity() / 1024.0,
+				frameArena.GetHighWaterMark() / 1024.0
+			);
+			ImGui::Separator();
+
+			// systems on the critical path are highlighted
+			for (const auto& system : schedulerReport.systems) {
+				const ImVec4 color = system.isOnCriticalPath ? ImVec4(1.0f, 0.6f, 0.2f, 1.0f) : ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+				ImGui::TextColored(color, "%-28s start %.3f ms, %.3f ms", system.name.c_str(), system.startMs, system.durationMs);
+			}
+		}
+		ImGui::End();
+
+		if (ImGui::Begin("Collision")) {
+			CollisionSystem& collisionSystem = registry->GetSystem<CollisionSystem>();
+			int broadphase = collisionSystem.GetBroadphase();
+			if (ImGui::Combo("broadphase", &broadphase, "grid\0tree\0sweep\0")) {
+				collisionSystem.SetBroadphase(static_cast<Broadphase>(broadphase));
+			}
+
+			const CollisionStats& stats = collisionSystem.GetStats();
+			ImGui::Text("%d colliders, %d tests, %d collisions, %.3f ms", stats.numColliders, stats.numTests, stats.numCollisions, stats.milliseconds);
+			ImGui::Text("%d static colliders, rebuilt %d times", stats.numStaticColliders, stats.numStaticRebuilds);
+			if (broadphase == BROADPHASE_TREE) {
+				ImGui::Text("tree height %d, %d proxies reinserted", stats.treeHeight, stats.numTreeMoves);
+			}
+
+			if (ImGui::TreeNode("Layer matrix")) {
+				const int numLayers = CollisionLayers::GetNumLayers();
+				for (int layerA = 0; layerA < numLayers; layerA++) {
+					for (int layerB = layerA; layerB < numLayers; layerB++) {
+						bool interact = collisionSystem.DoLayersInteract(layerA, layerB);
+						const std::string label = CollisionLayers::GetName(layerA) + " / " + CollisionLayers::GetName(layerB);
+						if (ImGui::Checkbox(label.c_str(), &interact)) {
+							collisionSystem.SetLayersInteract(layerA, layerB, interact);
+						}
+					}
+				}
+				ImGui::TreePop();
+			}
+
+			// benchmark: average collision and frame time per 250 colliders
+			const int numBuckets = 40;
+			const int collidersPerBucket = 250;
+			static float collisionMs[numBuckets] = {};
+			static float frameMs[numBuckets] = {};
+			const int bucket = std::min(stats.numColliders / collidersPerBucket, numBuckets - 1);
+			collisionMs[bucket] = collisionMs[bucket] == 0 ? static_cast<float>(stats.milliseconds) : 0.9f * collisionMs[bucket] + 0.1f * static_cast<float>(stats.milliseconds);
+			frameMs[bucket] = frameMs[bucket] == 0 ? static_cast<float>(schedulerReport.frameMs) : 0.9f * frameMs[bucket] + 0.1f * static_cast<float>(schedulerReport.frameMs);
+			ImGui::PlotHistogram("collision ms", collisionMs, numBuckets, 0, "per 250 colliders", 0.0f, FLT_MAX, ImVec2(0, 60));
+			ImGui::PlotHistogram("frame ms", frameMs, numBuckets, 0, "per 250 colliders", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+			static int numBenchmarkColliders = 500;
+			static bool areBenchmarkCollidersStatic = false;
+			ImGui::SliderInt("colliders", &numBenchmarkColliders, 100, 2000);
+			ImGui::Checkbox("static", &areBenchmarkCollidersStatic);
+			if (ImGui::Button("Spawn colliders")) {
+				for (int i = 0; i < numBenchmarkColliders; i++) {
+					Entity collider = registry->CreateEntity();
+					collider.Group("benchmark");
+					collider.AddComponent<TransformComponent>(glm::vec2(camera.x + rand() % camera.w, camera.y + rand() % camera.h));
+					if (areBenchmarkCollidersStatic) {
+						collider.AddComponent<StaticBodyComponent>();
+					} else {
+						collider.AddComponent<RigidBodyComponent>(glm::vec2(rand() % 101 - 50, rand() % 101 - 50));
+					}
+					collider.AddComponent<SpriteComponent>("bullet-texture", 4, 4, 4);
+					collider.AddComponent<BoxColliderComponent>(8, 8, glm::vec2(0), CollisionLayers::Intern("benchmark"));
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Kill benchmark colliders")) {
+				for (auto entity : registry->GetEntitiesByGroup("benchmark")) {
+					entity.Kill();
+				}
+			}
+		}
+		ImGui::End();
+
+		if (ImGui::Begin("Pools")) {
+			const std::vector<PoolStats> poolStats = registry->GetPoolStats();
+			size_t totalBytes = 0;
+			for (const auto& stats : poolStats) {
+				totalBytes += stats.bytes;
+			}
+			ImGui::Text("%d pools, %.1f KB", static_cast<int>(poolStats.size()), totalBytes / 1024.0);
+			ImGui::SameLine();
+			if (ImGui::Button("Compact")) {
+				registry->Compact();
+			}
+			ImGui::Separator();
+
+			for (const auto& stats : poolStats) {
+				ImGui::Text("%-28s %6d / %6d (%d reserved), %8.1f KB, %d growths, %d pages", stats.name.c_str(), stats.size, stats.capacity, stats.reservedCapacity, stats.bytes / 1024.0, stats.numGrowths, stats.numSparsePages);
+			}
+		}
+		ImGui::End();
+
+		if (ImGui::Begin("Console")) {
+			static const ImVec4 colors[] = { ImVec4(0.7f, 0.7f, 0.7f, 1.0f), ImVec4(0.4f, 1.0f, 0.4f, 1.0f), ImVec4(1.0f, 0.9f, 0.3f, 1.0f), ImVec4(1.0f, 0.4f, 0.4f, 1.0f) };
+			const std::vector<LogEntry> history = Logger::GetHistory();
+
+			ImGui::Text("Last %d messages, %d dropped", static_cast<int>(history.size()), Logger::GetNumDropped());
+			ImGui::Separator();
+
+			// only the visible lines are drawn
+			ImGui::BeginChild("ConsoleMessages");
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(history.size()));
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+					ImGui::TextColored(colors[history[i].type], "%s", history[i].message.c_str());
+				}
+			}
+			if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
+				ImGui::SetScrollHereY(1.0f);
+			}
+			ImGui::EndChild();
+		}
+		ImGui::End();
+
 		// render
 		ImGui::Render();
 		ImGui_ImplSDLRenderer_RenderDrawData(ImGui::GetDrawData());
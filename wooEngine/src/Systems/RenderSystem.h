@@ -3,6 +3,7 @@
 #include "../ECS/ECS.h"
 #include "../Components/TransformComponent.h"
 #include "../Components/SpriteComponent.h"
+#include "../Memory/FrameArena.h"
 #include <SDL.h>
 #include <algorithm>
 
@@ -15,69 +16,93 @@ public:
 
 	
 
-	void Update(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore, SDL_Rect& camera) {
-		// organize into struct that couples transform and sprite components
-		struct RenderableEntity {
-			TransformComponent transformComponent;
-			SpriteComponent spriteComponent;
+	// draw order: z index, then texture so sprites sharing a texture are drawn one after another
+	static bool CompareSprites(const SpriteComponent& a, const SpriteComponent& b) {
+		if (a.zIndex != b.zIndex) {
+			return a.zIndex < b.zIndex;
+		}
+		return a.assetId < b.assetId;
+	}
+
+	static void RenderSprite(SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore, const SDL_Rect& camera, const TransformComponent& transform, const SpriteComponent& sprite) {
+		// don't bother rendering entities outside of camera
+		bool isEntityOutsideCameraView = (
+			transform.position.x + (transform.scale.x * sprite.width) < camera.x ||
+			transform.position.x  > camera.x + camera.w ||
+			transform.position.y + (transform.scale.y * sprite.height) < camera.y ||
+			transform.position.y > camera.y + camera.h
+		);
+
+		if (isEntityOutsideCameraView && !sprite.isFixed) {
+			return;
+		}
+
+		// rectangle to carve out of original sprite texture
+		SDL_Rect srcRect = sprite.srcRect;
+
+		// where to draw entity on map
+		SDL_Rect dstRect = {
+			static_cast<int>(transform.position.x - (sprite.isFixed ? 0 : camera.x)),
+			static_cast<int>(transform.position.y - (sprite.isFixed ? 0 : camera.y)),
+			static_cast<int>(sprite.width * transform.scale.x),
+			static_cast<int>(sprite.height * transform.scale.y)
 		};
-		std::vector<RenderableEntity> renderableEntities;
-
-		// populate vector with relevant entities
-		for (auto entity : GetSystemEntities()) {
-			if (entity.HasComponent<TransformComponent>() && entity.HasComponent<SpriteComponent>()) {
-				RenderableEntity renderableEntity;
-				renderableEntity.transformComponent = entity.GetComponent<TransformComponent>();
-				renderableEntity.spriteComponent = entity.GetComponent<SpriteComponent>();
-
-				// don't bother rendering entities outside of camera
-				bool isEntityOutsideCameraView = (
-					renderableEntity.transformComponent.position.x + (renderableEntity.transformComponent.scale.x * renderableEntity.spriteComponent.width) < camera.x ||
-					renderableEntity.transformComponent.position.x  > camera.x + camera.w ||
-					renderableEntity.transformComponent.position.y + (renderableEntity.transformComponent.scale.y * renderableEntity.spriteComponent.height) < camera.y ||
-					renderableEntity.transformComponent.position.y > camera.y + camera.h
-				);
-
-				if (isEntityOutsideCameraView && !renderableEntity.spriteComponent.isFixed) {
-					continue;
-				}
-
-				renderableEntities.emplace_back(renderableEntity);
+
+		SDL_RenderCopyEx(
+			renderer,
+			assetStore->GetTexture(sprite.assetId),
+			&srcRect,
+			&dstRect,
+			transform.rotation,
+			NULL,
+			sprite.flip
+		);
+	}
+
+	void Update(const std::unique_ptr<Registry>& registry, SDL_Renderer* renderer, std::unique_ptr<AssetStore>& assetStore, SDL_Rect& camera, [[maybe_unused]] FrameArena& frameArena) {
+#ifndef WOO_ECS_ARCHETYPE_STORAGE
+		// the sprite pool itself is kept in draw order, few sprites change order between frames
+		// so the insertion sort only moves those, and drawing is a linear walk over the pool
+		registry->Sort<SpriteComponent>(CompareSprites, SORT_INSERTION);
+
+		const Pool<SpriteComponent>& spritePool = *registry->GetPool<SpriteComponent>();
+		Pool<TransformComponent>& transformPool = *registry->GetPool<TransformComponent>();
+		const auto& entities = spritePool.GetEntities();
+		const auto& sprites = spritePool.GetData();
+
+		for (size_t i = 0; i < sprites.size(); i++) {
+			// components removed this frame keep their data in the pools until the next registry
+			// update, the signature already dropped them so it decides what is drawn
+			if (!registry->HasComponent<SpriteComponent>(entities[i]) || !registry->HasComponent<TransformComponent>(entities[i])) {
+				continue;
+			}
+			if (const TransformComponent* transform = transformPool.TryGet(entities[i].GetId())) {
+				RenderSprite(renderer, assetStore, camera, *transform, sprites[i]);
 			}
 		}
+#else
+		// organize into struct that couples transform and sprite components
+		// components are referenced in place, pools are not modified while rendering
+		struct RenderableEntity {
+			const TransformComponent* transformComponent;
+			const SpriteComponent* spriteComponent;
+		};
 
-		//sort by zIndex
-		std::sort(renderableEntities.begin(), renderableEntities.end(), [](const RenderableEntity& a, const RenderableEntity& b) {
-			return a.spriteComponent.zIndex < b.spriteComponent.zIndex;
+		auto view = registry->View<TransformComponent, SpriteComponent>();
+		FrameVector<RenderableEntity> renderableEntities(frameArena.GetAllocator<RenderableEntity>());
+		renderableEntities.reserve(view.SizeHint());
+
+		view.Each([&renderableEntities](Entity, const TransformComponent& transform, const SpriteComponent& sprite) {
+			renderableEntities.push_back({&transform, &sprite});
 		});
 
-		// render entities
-		for (auto entity : renderableEntities) {
-			// update position based on velocity
-			const auto& transform = entity.transformComponent;
-			const auto& sprite = entity.spriteComponent;
-
-			// rectangle to carve out of original sprite texture
-			SDL_Rect srcRect = sprite.srcRect;
-
-			// where to draw entity on map
-			SDL_Rect dstRect = {
-				static_cast<int>(transform.position.x - (sprite.isFixed ? 0 : camera.x)),
-				static_cast<int>(transform.position.y - (sprite.isFixed ? 0 : camera.y)),
-				static_cast<int>(sprite.width * transform.scale.x),
-				static_cast<int>(sprite.height * transform.scale.y)
-			};
-
-			SDL_RenderCopyEx(
-				renderer,
-				assetStore->GetTexture(sprite.assetId),
-				&srcRect,
-				&dstRect,
-				transform.rotation,
-				NULL,
-				sprite.flip
-			);
+		std::sort(renderableEntities.begin(), renderableEntities.end(), [](const RenderableEntity& a, const RenderableEntity& b) {
+			return CompareSprites(*a.spriteComponent, *b.spriteComponent);
+		});
 
+		for (const auto& entity : renderableEntities) {
+			RenderSprite(renderer, assetStore, camera, *entity.transformComponent, *entity.spriteComponent);
 		}
+#endif
 	}
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../ECS/ECS.h"
 #include "../Components/ScriptComponent.h"
 #include "../Components/TransformComponent.h"
+#include "../Components/ParentComponent.h"
 
 // native cpp functions for binding with lua
 std::tuple<double, double> GetEntityPosition(Entity entity) {
@@ -28,9 +29,10 @@ std::tuple<double, double> GetEntityVelocity(Entity entity) {
 
 void SetEntityPosition(Entity entity, double x, double y) {
 	if (entity.HasComponent<TransformComponent>()) {
-		auto& transform = entity.GetComponent<TransformComponent>();
-		transform.position.x = x;
-		transform.position.y = y;
+		entity.Patch<TransformComponent>([x, y](TransformComponent& transform) {
+			transform.position.x = x;
+			transform.position.y = y;
+		});
 	}
 	else {
 		Logger::Err("Attempt to set position of entity with no transform component");
@@ -50,14 +52,38 @@ void SetEntityVelocity(Entity entity, double x, double y) {
 
 void SetEntityRotation(Entity entity, double angle) {
 	if (entity.HasComponent<TransformComponent>()) {
-		auto& transform = entity.GetComponent<TransformComponent>();
-		transform.rotation = angle;
+		entity.Patch<TransformComponent>([angle](TransformComponent& transform) {
+			transform.rotation = angle;
+		});
 	}
 	else {
 		Logger::Err("Attempt to set rotation of entity with no transform component");
 	}
 }
 
+void SetEntityLocalPosition(Entity entity, double x, double y) {
+	if (entity.HasComponent<ParentComponent>()) {
+		entity.Patch<ParentComponent>([x, y](ParentComponent& parent) {
+			parent.localPosition.x = x;
+			parent.localPosition.y = y;
+		});
+	}
+	else {
+		Logger::Err("Attempt to set local position of entity with no parent component");
+	}
+}
+
+void SetEntityLocalRotation(Entity entity, double angle) {
+	if (entity.HasComponent<ParentComponent>()) {
+		entity.Patch<ParentComponent>([angle](ParentComponent& parent) {
+			parent.localRotation = angle;
+		});
+	}
+	else {
+		Logger::Err("Attempt to set local rotation of entity with no parent component");
+	}
+}
+
 void SetEntityAnimationFrame(Entity entity, int frame) {
 	if (entity.HasComponent<AnimationComponent>()) {
 		auto& animation = entity.GetComponent<AnimationComponent>();
@@ -83,6 +109,9 @@ class ScriptSystem : public System {
 public:
 	ScriptSystem() {
 		RequireComponent<ScriptComponent>();
+
+		// lua scripts can reach any component through the bindings
+		SetExclusive();
 	}
 
 	void CreateLuaBindings(sol::state& lua) {
@@ -90,9 +119,10 @@ public:
 		lua.new_usertype<Entity>(
 			"entity",
 			"get_id", &Entity::GetId,
+			"is_alive", &Entity::IsAlive,
 			"destroy", &Entity::Kill,
-			"has_tag", &Entity::HasTag,
-			"belongs_to_group", &Entity::BelongsToGroup
+			"has_tag", sol::resolve<bool(const std::string&) const>(&Entity::HasTag),
+			"belongs_to_group", sol::resolve<bool(const std::string&) const>(&Entity::BelongsToGroup)
 			);
 
 		lua.set_function("set_position", SetEntityPosition);
@@ -100,6 +130,8 @@ public:
 		lua.set_function("set_velocity", SetEntityVelocity);
 		lua.set_function("get_velocity", GetEntityVelocity);
 		lua.set_function("set_rotation", SetEntityRotation);
+		lua.set_function("set_local_position", SetEntityLocalPosition);
+		lua.set_function("set_local_rotation", SetEntityLocalRotation);
 		lua.set_function("set_projectile_velocity", SetProjectileVelocity);
 		lua.set_function("set_animation_frame", SetEntityAnimationFrame);
 	}